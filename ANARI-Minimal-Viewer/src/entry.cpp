@@ -7,6 +7,8 @@
 #include <chrono>
 #include <array>
 
+#include "common.h"
+
 using uvec2 = unsigned int[2];
 using uvec3 = unsigned int[3];
 using ivec2 = int[2];
@@ -20,8 +22,15 @@ struct {
 	anari::Camera perspectiveCamera {nullptr};
 
 	anari::Frame frame {nullptr};
+
+	// the device reports finished frames through a callback, see frame_completed()
+	bool completionCallback = false;
+	bool rendering = false;
 } g_ANARIState; // ANARI Device and Scene handle
 
+// frames finished by the device, pushed from its render thread
+static mpsc_queue<ANARIFrame, 4> g_completedFrames;
+
 struct
 {
 	GLFWwindow* nativeWindow = nullptr;
@@ -69,6 +78,12 @@ static void status_callback (const void* userData, ANARIDevice device, ANARIObje
 	}
 }
 
+// called on a device thread, wakes the main loop blocked in glfwWaitEvents()
+static void frame_completed (const void* userData, ANARIDevice device, ANARIFrame frame) {
+	g_completedFrames.push (frame);
+	glfwPostEmptyEvent ();
+}
+
 static void initialize_ALL() {
 	g_AppState.size = {1280, 720};
 
@@ -86,6 +101,8 @@ static void initialize_ALL() {
 		// if (!extensions.ANARI_KHR_CAMERA_PERSPECTIVE) {
 		// 	throw std::runtime_error("device doesn't support ANARI_KHR_CAMERA_PERSPECTIVE");
 		// }
+		anari::Extensions extensions = anari::extension::getDeviceExtensionStruct(library, "default");
+		g_ANARIState.completionCallback = extensions.ANARI_KHR_FRAME_COMPLETION_CALLBACK;
 
 		auto dev = g_ANARIState.device = anariNewDevice(library, "default");
 
@@ -190,6 +207,11 @@ static void initialize_ALL() {
 		anari::setAndReleaseParameter(d, frame, "renderer", renderer);
 		anari::setAndReleaseParameter(d, frame, "world", scene);
 
+		if (g_ANARIState.completionCallback) {
+			ANARIFrameCompletionCallback callback = &frame_completed;
+			anari::setParameter(d, frame, "frameCompletionCallback", ANARI_FRAME_COMPLETION_CALLBACK, &callback);
+		}
+
 		anari::commitParameters(d, frame);
 	}
 
@@ -302,12 +324,24 @@ static bool window_condition() {
 	g_AppState.currentFrameStartTime = now;
 	g_AppState.size.resized = false;
 
-	glfwPollEvents();
+	// with a frame in flight there is nothing to do until it completes or input arrives
+	if (g_ANARIState.completionCallback && g_ANARIState.rendering) {
+		glfwWaitEvents();
+	} else {
+		glfwPollEvents();
+	}
 	return should_close;
 }
 
 static void update() {
 	if (g_AppState.size.resized) {
+		// the frame in flight was sized for the old framebuffer
+		if (g_ANARIState.rendering) {
+			anari::wait(g_ANARIState.device, g_ANARIState.frame);
+			for (ANARIFrame completed; g_completedFrames.pop(completed);) {}
+			g_ANARIState.rendering = false;
+		}
+
 		// ANARI
 		const uvec2 fb_size = {unsigned(g_AppState.size.width), unsigned(g_AppState.size.height)};
 
@@ -332,10 +366,24 @@ static void update() {
 			0);
 	}
 
+	if (g_ANARIState.completionCallback) {
+		if (!g_ANARIState.rendering) {
+			anari::render(g_ANARIState.device, g_ANARIState.frame);
+			g_ANARIState.rendering = true;
+		}
 
-
-	anari::render(g_ANARIState.device, g_ANARIState.frame);
-	anari::wait(g_ANARIState.device, g_ANARIState.frame);
+		bool completed = false;
+		for (ANARIFrame frame; g_completedFrames.pop(frame);) {
+			completed = true;
+		}
+		if (!completed) {
+			return; // woken up by input, the frame is still rendering
+		}
+		g_ANARIState.rendering = false;
+	} else {
+		anari::render(g_ANARIState.device, g_ANARIState.frame);
+		anari::wait(g_ANARIState.device, g_ANARIState.frame);
+	}
 
 	auto fb = anari::map<uint32_t>(g_ANARIState.device, g_ANARIState.frame, "channel.color");
 
@@ -355,6 +403,12 @@ static void update() {
 
 	anari::unmap(g_ANARIState.device, g_ANARIState.frame, "channel.color");
 
+	// the device renders the next frame while this one is drawn and swapped
+	if (g_ANARIState.completionCallback) {
+		anari::render(g_ANARIState.device, g_ANARIState.frame);
+		g_ANARIState.rendering = true;
+	}
+
 	// draw to screen
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glDisable(GL_DEPTH_TEST);
@@ -367,6 +421,11 @@ static void update() {
 }
 
 static void terminate_ALL() {
+	// a late completion callback must not post to a terminated GLFW
+	if (g_ANARIState.rendering) {
+		anari::wait(g_ANARIState.device, g_ANARIState.frame);
+	}
+
 	{ // GLFW
 		glfwDestroyWindow(g_AppState.nativeWindow);
 		glfwTerminate();
@@ -0,0 +1,162 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#include "CameraPath.h"
+#include "FrameStats.h"
+// std
+#include <cstdio>
+#include <utility>
+
+namespace my_viewer {
+
+static const char *HEADER =
+    "# anariViewer camera path: time at.x at.y at.z distance az el axis";
+
+void CameraPath::record(const manipulators::Orbit &orbit, float time)
+{
+  CameraKey key;
+  key.time = time;
+  key.at = orbit.at();
+  key.distance = orbit.distance();
+  key.azel = orbit.azel();
+  key.axis = orbit.axis();
+  m_keys.push_back(key);
+}
+
+void CameraPath::clear()
+{
+  m_keys.clear();
+}
+
+bool CameraPath::empty() const
+{
+  return m_keys.empty();
+}
+
+size_t CameraPath::size() const
+{
+  return m_keys.size();
+}
+
+const CameraKey &CameraPath::operator[](size_t i) const
+{
+  return m_keys[i];
+}
+
+bool CameraPath::save(const char *fileName) const
+{
+  FILE *file = fopen(fileName, "w");
+  if (!file)
+    return false;
+
+  // %.9g round trips every float, playback sees the exact recorded views
+  fprintf(file, "%s\n", HEADER);
+  for (const auto &k : m_keys) {
+    fprintf(file,
+        "%.9g %.9g %.9g %.9g %.9g %.9g %.9g %i\n",
+        k.time,
+        k.at.x,
+        k.at.y,
+        k.at.z,
+        k.distance,
+        k.azel.x,
+        k.azel.y,
+        int(k.axis));
+  }
+
+  fclose(file);
+  return true;
+}
+
+bool CameraPath::load(const char *fileName)
+{
+  FILE *file = fopen(fileName, "r");
+  if (!file)
+    return false;
+
+  std::vector<CameraKey> keys;
+  bool ok = true;
+
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    if (line[0] == '#' || line[0] == '\n')
+      continue;
+
+    CameraKey k;
+    int axis = 0;
+    if (sscanf(line,
+            "%f %f %f %f %f %f %f %i",
+            &k.time,
+            &k.at.x,
+            &k.at.y,
+            &k.at.z,
+            &k.distance,
+            &k.azel.x,
+            &k.azel.y,
+            &axis)
+            != 8
+        || axis < 0 || axis > int(manipulators::OrbitAxis::NEG_Z)) {
+      ok = false;
+      break;
+    }
+    k.axis = manipulators::OrbitAxis(axis);
+    keys.push_back(k);
+  }
+
+  fclose(file);
+
+  if (ok)
+    m_keys = std::move(keys);
+  return ok;
+}
+
+void CameraPath::apply(const CameraKey &key, manipulators::Orbit &orbit)
+{
+  orbit.setAxis(key.axis);
+  orbit.setConfig(key.at, key.distance, key.azel);
+}
+
+bool CameraPath::writeReport(const char *fileName,
+    const std::vector<KeyTiming> &timings,
+    int samplesPerKey)
+{
+  FILE *file = fopen(fileName, "w");
+  if (!file)
+    return false;
+
+  fprintf(file, "key,samples,frames,first_frame_ms,total_ms,device_ms\n");
+
+  std::vector<float> firstFrame;
+  std::vector<float> total;
+  for (size_t i = 0; i < timings.size(); i++) {
+    const auto &t = timings[i];
+    fprintf(file,
+        "%zu,%i,%i,%.4f,%.4f,%.4f\n",
+        i,
+        samplesPerKey,
+        t.frames,
+        t.firstFrame,
+        t.total,
+        t.device);
+    firstFrame.push_back(t.firstFrame);
+    total.push_back(t.total);
+  }
+
+  fclose(file);
+
+  printf("camera path: %zu keys, %i samples each\n",
+      timings.size(),
+      samplesPerKey);
+  printf("  first frame: p50 %.2fms | p95 %.2fms | max %.2fms\n",
+      FrameStats::percentile(firstFrame, 0.5f),
+      FrameStats::percentile(firstFrame, 0.95f),
+      FrameStats::percentile(firstFrame, 1.f));
+  printf("  all samples: p50 %.2fms | p95 %.2fms | max %.2fms\n",
+      FrameStats::percentile(total, 0.5f),
+      FrameStats::percentile(total, 0.95f),
+      FrameStats::percentile(total, 1.f));
+
+  return true;
+}
+
+} // namespace my_viewer
@@ -0,0 +1,57 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "Orbit.h"
+// std
+#include <vector>
+
+namespace my_viewer {
+
+// Orbit manipulator state, enough to reproduce any view
+struct CameraKey
+{
+  float time{0.f}; // seconds since recording began
+  anari::math::float3 at{0.f};
+  float distance{1.f};
+  anari::math::float2 azel{0.f};
+  manipulators::OrbitAxis axis{manipulators::OrbitAxis::POS_Y};
+};
+
+// Timings of one key during playback, in milliseconds
+struct KeyTiming
+{
+  int frames{0}; // frames presented until the key held all its samples
+  float firstFrame{0.f}; // key applied until its first frame was presented
+  float total{0.f}; // key applied until it held all its samples
+  float device{0.f}; // "duration" reported by the devices, summed
+};
+
+// A timeline of manipulator states, stored as text with one key per line
+class CameraPath
+{
+ public:
+  // appends the current state of orbit
+  void record(const manipulators::Orbit &orbit, float time);
+  void clear();
+
+  bool empty() const;
+  size_t size() const;
+  const CameraKey &operator[](size_t i) const;
+
+  bool save(const char *fileName) const;
+  bool load(const char *fileName);
+
+  static void apply(const CameraKey &key, manipulators::Orbit &orbit);
+
+  // one CSV row per key followed by the latency percentiles on stdout
+  static bool writeReport(const char *fileName,
+      const std::vector<KeyTiming> &timings,
+      int samplesPerKey);
+
+ private:
+  std::vector<CameraKey> m_keys;
+};
+
+} // namespace my_viewer
@@ -0,0 +1,274 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Denoiser.h"
+#include "ThreadPool.h"
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define DENOISER_SSE 1
+#endif
+
+#include "common.h"
+
+namespace my_viewer {
+
+// albedo below this is not divided out, black texels keep their color
+static constexpr float MIN_ALBEDO = 1e-3f;
+// depth at or beyond this is a miss, see Reprojector
+static constexpr float BACKGROUND_DEPTH = 1e30f;
+// B3 spline weights for taps 0, 1 and 2 pixel steps from the center
+static constexpr float KERNEL[3] = {3.f / 8.f, 1.f / 4.f, 1.f / 16.f};
+// keeps the color term finite where the neighborhood is flat
+static constexpr float MIN_VARIANCE = 1e-4f;
+
+// an RGBA texel, one SSE register where available
+#if DENOISER_SSE
+using Texel = __m128;
+
+static Texel load(const float *p)
+{
+  return _mm_loadu_ps(p);
+}
+
+static void store(float *p, Texel t)
+{
+  _mm_storeu_ps(p, t);
+}
+
+static Texel zero()
+{
+  return _mm_setzero_ps();
+}
+
+static Texel madd(Texel acc, float w, Texel t)
+{
+  return _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w), t));
+}
+
+static Texel scale(Texel t, float s)
+{
+  return _mm_mul_ps(t, _mm_set1_ps(s));
+}
+
+static Texel mul(Texel a, Texel b)
+{
+  return _mm_mul_ps(a, b);
+}
+
+static float sumRGB(Texel t)
+{
+  __m128 sum = _mm_add_ss(t, _mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 1, 1, 1)));
+  sum = _mm_add_ss(sum, _mm_movehl_ps(t, t));
+  return _mm_cvtss_f32(sum);
+}
+
+// squared distance of the RGB lanes
+static float distanceSq(Texel a, Texel b)
+{
+  const __m128 d = _mm_sub_ps(a, b);
+  return sumRGB(_mm_mul_ps(d, d));
+}
+#else
+struct Texel
+{
+  float v[4];
+};
+
+static Texel load(const float *p)
+{
+  return {{p[0], p[1], p[2], p[3]}};
+}
+
+static void store(float *p, Texel t)
+{
+  std::copy(t.v, t.v + 4, p);
+}
+
+static Texel zero()
+{
+  return {{0.f, 0.f, 0.f, 0.f}};
+}
+
+static Texel madd(Texel acc, float w, Texel t)
+{
+  for (int k = 0; k < 4; k++)
+    acc.v[k] += w * t.v[k];
+  return acc;
+}
+
+static Texel scale(Texel t, float s)
+{
+  for (int k = 0; k < 4; k++)
+    t.v[k] *= s;
+  return t;
+}
+
+static Texel mul(Texel a, Texel b)
+{
+  for (int k = 0; k < 4; k++)
+    a.v[k] *= b.v[k];
+  return a;
+}
+
+static float sumRGB(Texel t)
+{
+  return t.v[0] + t.v[1] + t.v[2];
+}
+
+static float distanceSq(Texel a, Texel b)
+{
+  float sum = 0.f;
+  for (int k = 0; k < 3; k++)
+    sum += (a.v[k] - b.v[k]) * (a.v[k] - b.v[k]);
+  return sum;
+}
+#endif
+
+static float distanceSq3(const float *a, const float *b)
+{
+  const float x = a[0] - b[0];
+  const float y = a[1] - b[1];
+  const float z = a[2] - b[2];
+  return x * x + y * y + z * z;
+}
+
+void Denoiser::apply(int width,
+    int height,
+    float *color,
+    const float *albedo,
+    const float *normal,
+    const float *depth)
+{
+  TRACE_SCOPE("Denoiser::apply");
+
+  if (iterations <= 0 || width <= 0 || height <= 0)
+    return;
+
+  const size_t numTexels = size_t(width) * height * 4;
+  m_ping.resize(numTexels);
+  m_pong.resize(numTexels);
+  m_variance.resize(size_t(width) * height);
+
+  auto &pool = ThreadPool::global();
+
+  // filter the lighting only, albedo is multiplied back in the last pass
+  pool.parallelFor(0, height, [&](size_t y) {
+    for (size_t i = y * width; i < (y + 1) * width; i++) {
+      float *dst = &m_ping[i * 4];
+      std::copy(color + i * 4, color + i * 4 + 4, dst);
+      if (albedo) {
+        for (int k = 0; k < 3; k++) {
+          const float a = albedo[i * 3 + k];
+          if (a > MIN_ALBEDO)
+            dst[k] /= a;
+        }
+      }
+    }
+  });
+
+  const float invNormalPhiSq = 1.f / (normalPhi * normalPhi);
+  const float colorPhiSq = colorPhi * colorPhi;
+
+  for (int pass = 0; pass < iterations; pass++) {
+    const int step = 1 << pass;
+    const float invDepthPhi = 1.f / (depthPhi * step);
+    const bool last = pass == iterations - 1;
+    const float *src = m_ping.data();
+    float *dst = last ? color : m_pong.data();
+
+    // the color term is relative to the noise left in the image, so early
+    // passes blur across the noise and later ones only across real edges
+    pool.parallelFor(0, height, [&](size_t y) {
+      for (int x = 0; x < width; x++) {
+        const int yBegin = std::max(0, int(y) - 1);
+        const int yEnd = std::min(height - 1, int(y) + 1);
+        const int xBegin = std::max(0, x - 1);
+        const int xEnd = std::min(width - 1, x + 1);
+        Texel mean = zero();
+        Texel meanSq = zero();
+        int n = 0;
+        for (int ny = yBegin; ny <= yEnd; ny++) {
+          for (int nx = xBegin; nx <= xEnd; nx++) {
+            const Texel t = load(src + (size_t(ny) * width + nx) * 4);
+            mean = madd(mean, 1.f, t);
+            meanSq = madd(meanSq, 1.f, mul(t, t));
+            n++;
+          }
+        }
+        mean = scale(mean, 1.f / n);
+        meanSq = scale(meanSq, 1.f / n);
+        // sum of the RGB variances
+        const float variance = sumRGB(meanSq) - sumRGB(mul(mean, mean));
+        m_variance[y * width + x] =
+            colorPhiSq * std::max(variance, MIN_VARIANCE);
+      }
+    });
+
+    pool.parallelFor(0, height, [&](size_t y) {
+      for (int x = 0; x < width; x++) {
+        const size_t i = y * width + x;
+        const Texel c = load(src + i * 4);
+        const float invColorPhiSq = 1.f / m_variance[i];
+        const float *n = normal ? normal + i * 3 : nullptr;
+        const float z = depth ? depth[i] : 0.f;
+        const bool background = !(z < BACKGROUND_DEPTH);
+
+        Texel sum = zero();
+        float weightSum = 0.f;
+
+        for (int dy = -2; dy <= 2; dy++) {
+          const int qy = int(y) + dy * step;
+          if (qy < 0 || qy >= height)
+            continue;
+          for (int dx = -2; dx <= 2; dx++) {
+            const int qx = x + dx * step;
+            if (qx < 0 || qx >= width)
+              continue;
+
+            const size_t j = size_t(qy) * width + qx;
+            const Texel cq = load(src + j * 4);
+
+            float e = distanceSq(c, cq) * invColorPhiSq;
+            if (n)
+              e += distanceSq3(n, normal + j * 3) * invNormalPhiSq;
+            if (depth) {
+              // surfaces never blend with the background and vice versa
+              const float zq = depth[j];
+              if (background != !(zq < BACKGROUND_DEPTH))
+                continue;
+              if (!background && z > 0.f) {
+                const float dz = (z - zq) * invDepthPhi / z;
+                e += dz * dz;
+              }
+            }
+
+            const float w = KERNEL[std::abs(dx)] * KERNEL[std::abs(dy)]
+                * std::exp(-e);
+            sum = madd(sum, w, cq);
+            weightSum += w;
+          }
+        }
+
+        // the center tap is always taken, weightSum is never zero
+        store(dst + i * 4, scale(sum, 1.f / weightSum));
+
+        if (last && albedo) {
+          for (int k = 0; k < 3; k++) {
+            const float a = albedo[i * 3 + k];
+            if (a > MIN_ALBEDO)
+              dst[i * 4 + k] *= a;
+          }
+        }
+      }
+    });
+
+    if (!last)
+      std::swap(m_ping, m_pong);
+  }
+}
+
+} // namespace my_viewer
@@ -0,0 +1,41 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <vector>
+
+namespace my_viewer {
+
+// Edge-avoiding à-trous wavelet filter (Dammertz et al. 2010) for frames
+// with few samples. Every pass blurs with a 5x5 B3 spline kernel whose taps
+// are spread 2^i pixels apart and weighted down across color, normal and
+// depth edges. Color distances are measured against the local variance of
+// the image being filtered, as in SVGF. With albedo, texture detail is
+// divided out before filtering and multiplied back afterwards, so only the
+// lighting is smoothed.
+class Denoiser
+{
+ public:
+  // color is RGBA32F and receives the filtered result. albedo and normal are
+  // RGB and depth is the distance from the eye, each of them may be null.
+  void apply(int width,
+      int height,
+      float *color,
+      const float *albedo,
+      const float *normal,
+      const float *depth);
+
+  int iterations{4};
+  float colorPhi{4.f}; // color distance tolerated, in local deviations
+  float normalPhi{0.3f}; // distance between unit normals tolerated
+  float depthPhi{0.05f}; // relative depth difference tolerated per pixel
+
+ private:
+  std::vector<float> m_ping;
+  std::vector<float> m_pong;
+  std::vector<float> m_variance; // scaled by colorPhi squared
+};
+
+} // namespace my_viewer
@@ -0,0 +1,124 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#include "FrameStats.h"
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace my_viewer {
+
+void FrameStats::push(const FrameSample &sample)
+{
+  const uint64_t head = m_head.load(std::memory_order_relaxed);
+  m_samples[head % CAPACITY] = sample;
+  m_head.store(head + 1, std::memory_order_release);
+}
+
+void FrameStats::clear()
+{
+  const uint64_t head = m_head.load(std::memory_order_acquire);
+  m_tail.store(head, std::memory_order_release);
+}
+
+size_t FrameStats::size() const
+{
+  const uint64_t head = m_head.load(std::memory_order_acquire);
+  const uint64_t tail = m_tail.load(std::memory_order_acquire);
+  return size_t(std::min<uint64_t>(head - tail, CAPACITY));
+}
+
+std::vector<FrameSample> FrameStats::snapshot() const
+{
+  const uint64_t head = m_head.load(std::memory_order_acquire);
+  const uint64_t count = size();
+
+  std::vector<FrameSample> retval;
+  retval.reserve(count);
+  for (uint64_t i = head - count; i < head; i++)
+    retval.push_back(m_samples[i % CAPACITY]);
+
+  return retval;
+}
+
+std::vector<float> FrameStats::snapshot(Field f) const
+{
+  std::vector<float> retval;
+  for (auto &s : snapshot())
+    retval.push_back(value(s, f));
+  return retval;
+}
+
+bool FrameStats::writeCSV(const char *fileName) const
+{
+  FILE *file = fopen(fileName, "w");
+  if (!file)
+    return false;
+
+  fprintf(file, "frame");
+  for (int f = 0; f < FIELD_COUNT; f++)
+    fprintf(file, ",%s_ms", name(Field(f)));
+  fprintf(file, "\n");
+
+  const auto samples = snapshot();
+  for (size_t i = 0; i < samples.size(); i++) {
+    fprintf(file, "%zu", i);
+    for (int f = 0; f < FIELD_COUNT; f++)
+      fprintf(file, ",%.4f", value(samples[i], Field(f)));
+    fprintf(file, "\n");
+  }
+
+  fclose(file);
+  return true;
+}
+
+float FrameStats::value(const FrameSample &s, Field f)
+{
+  switch (f) {
+  case DEVICE:
+    return s.device;
+  case MAP:
+    return s.map;
+  case UPLOAD:
+    return s.upload;
+  case UI:
+    return s.ui;
+  case PRESENT:
+    return s.present;
+  default:
+    return 0.f;
+  }
+}
+
+const char *FrameStats::name(Field f)
+{
+  switch (f) {
+  case DEVICE:
+    return "device";
+  case MAP:
+    return "map";
+  case UPLOAD:
+    return "upload";
+  case UI:
+    return "ui";
+  case PRESENT:
+    return "present";
+  default:
+    return "unknown";
+  }
+}
+
+float FrameStats::percentile(std::vector<float> values, float p)
+{
+  if (values.empty())
+    return 0.f;
+
+  const size_t n = values.size();
+  size_t rank = size_t(std::ceil(std::clamp(p, 0.f, 1.f) * n));
+  rank = std::min(rank > 0 ? rank - 1 : 0, n - 1);
+  std::nth_element(values.begin(), values.begin() + rank, values.end());
+  return values[rank];
+}
+
+} // namespace my_viewer
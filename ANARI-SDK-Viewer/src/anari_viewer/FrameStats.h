@@ -0,0 +1,65 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace my_viewer {
+
+// Timings of one presented frame, all in milliseconds
+struct FrameSample
+{
+  float device{0.f}; // "duration" reported by the device
+  float map{0.f}; // anari::map() of the color channel
+  float upload{0.f}; // texture upload of the mapped channel
+  float ui{0.f}; // ImGui frame construction
+  float present{0.f}; // ImGui render + buffer swap
+};
+
+// Fixed size ring of the most recent frame samples. There is a single
+// producer, push() never locks or allocates and readers take snapshots.
+class FrameStats
+{
+ public:
+  static constexpr size_t CAPACITY = 1024;
+
+  enum Field
+  {
+    DEVICE,
+    MAP,
+    UPLOAD,
+    UI,
+    PRESENT,
+    FIELD_COUNT
+  };
+
+  void push(const FrameSample &sample);
+  void clear();
+
+  size_t size() const;
+
+  // oldest sample first
+  std::vector<FrameSample> snapshot() const;
+  std::vector<float> snapshot(Field f) const;
+
+  bool writeCSV(const char *fileName) const;
+
+  static float value(const FrameSample &s, Field f);
+  static const char *name(Field f);
+
+  // p in [0, 1], nearest-rank on a copy of the values
+  static float percentile(std::vector<float> values, float p);
+
+ private:
+  std::array<FrameSample, CAPACITY> m_samples;
+  std::atomic<uint64_t> m_head{0};
+  std::atomic<uint64_t> m_tail{0};
+};
+
+} // namespace my_viewer
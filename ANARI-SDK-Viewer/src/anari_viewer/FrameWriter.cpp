@@ -0,0 +1,172 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#include "FrameWriter.h"
+// std
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+// stb_image
+#include "stb_image_write.h"
+#ifndef _WIN32
+#include "external/tinyexr/tinyexr.h"
+#endif
+
+#include "common.h"
+
+namespace my_viewer {
+
+// buffers beyond this many are freed instead of pooled
+static constexpr size_t MAX_POOLED_BUFFERS = 4;
+
+static void appendBytes(void *context, void *data, int size)
+{
+  auto *bytes = static_cast<std::vector<uint8_t> *>(context);
+  auto *begin = static_cast<const uint8_t *>(data);
+  bytes->insert(bytes->end(), begin, begin + size);
+}
+
+size_t FrameWriter::Image::rowBytes() const
+{
+  return size_t(width) * 4 * (isFloat ? sizeof(float) : 1);
+}
+
+FrameWriter::FrameWriter(ThreadPool &pool) : m_pool(pool) {}
+
+FrameWriter::~FrameWriter()
+{
+  wait();
+}
+
+FrameWriter::Image FrameWriter::acquire(int width, int height, bool isFloat)
+{
+  Image image;
+  image.width = width;
+  image.height = height;
+  image.isFloat = isFloat;
+
+  {
+    std::lock_guard<std::mutex> lock(m_poolMutex);
+    if (!m_buffers.empty()) {
+      image.pixels = std::move(m_buffers.back());
+      m_buffers.pop_back();
+    }
+  }
+
+  // keeps the capacity of a pooled buffer that is large enough
+  image.pixels.resize(image.rowBytes() * height);
+  return image;
+}
+
+std::string FrameWriter::write(Image image, const std::string &baseName)
+{
+#ifdef _WIN32
+  const char *extension = image.isFloat ? ".hdr" : ".png";
+#else
+  const char *extension = image.isFloat ? ".exr" : ".png";
+#endif
+  std::string fileName = baseName + extension;
+
+  const uint64_t sequence = m_nextSequence++;
+  m_pending++;
+
+  auto shared = std::make_shared<Image>(std::move(image));
+  m_pool.enqueue([this, sequence, shared, fileName]() {
+    encode(sequence, *shared, fileName);
+  });
+
+  return fileName;
+}
+
+int FrameWriter::pending() const
+{
+  return m_pending;
+}
+
+void FrameWriter::wait()
+{
+  std::unique_lock<std::mutex> lock(m_writeMutex);
+  m_drained.wait(lock, [&]() { return m_pending == 0; });
+}
+
+void FrameWriter::encode(uint64_t sequence, Image &image, std::string fileName)
+{
+  TRACE_SCOPE("FrameWriter::encode");
+
+  Encoded encoded;
+  encoded.fileName = std::move(fileName);
+
+  if (!image.isFloat) {
+    stbi_write_png_to_func(appendBytes,
+        &encoded.bytes,
+        image.width,
+        image.height,
+        4,
+        image.pixels.data(),
+        int(image.rowBytes()));
+  } else {
+    const auto *texels = reinterpret_cast<const float *>(image.pixels.data());
+#ifdef _WIN32
+    stbi_write_hdr_to_func(appendBytes,
+        &encoded.bytes,
+        image.width,
+        image.height,
+        4,
+        texels);
+#else
+    const unsigned char *buffer = nullptr;
+    const char *err = nullptr;
+    const int size = SaveEXRToMemory(
+        texels, image.width, image.height, 4, 0, &buffer, &err);
+    if (size > 0) {
+      encoded.bytes.assign(buffer, buffer + size);
+      free((void *)buffer);
+    } else if (err) {
+      printf("Error encoding EXR: %s\n", err);
+      FreeEXRErrorMessage(err);
+    }
+#endif
+  }
+
+  recycle(std::move(image.pixels));
+  finish(sequence, std::move(encoded));
+}
+
+void FrameWriter::finish(uint64_t sequence, Encoded encoded)
+{
+  std::lock_guard<std::mutex> lock(m_writeMutex);
+  m_encoded.emplace(sequence, std::move(encoded));
+
+  // whichever thread completes the oldest frame writes out every frame that
+  // is ready behind it
+  auto next = m_encoded.begin();
+  while (next != m_encoded.end() && next->first == m_nextToWrite) {
+    const Encoded &e = next->second;
+    if (e.bytes.empty()) {
+      printf("failed to encode '%s'\n", e.fileName.c_str());
+    } else {
+      std::ofstream file(e.fileName, std::ios::binary);
+      file.write(reinterpret_cast<const char *>(e.bytes.data()),
+          std::streamsize(e.bytes.size()));
+      if (file)
+        printf("frame saved to '%s'\n", e.fileName.c_str());
+      else
+        printf("failed to write '%s'\n", e.fileName.c_str());
+    }
+    next = m_encoded.erase(next);
+    m_nextToWrite++;
+    m_pending--;
+  }
+
+  m_drained.notify_all();
+}
+
+void FrameWriter::recycle(std::vector<uint8_t> pixels)
+{
+  std::lock_guard<std::mutex> lock(m_poolMutex);
+  if (m_buffers.size() < MAX_POOLED_BUFFERS)
+    m_buffers.push_back(std::move(pixels));
+}
+
+} // namespace my_viewer
@@ -0,0 +1,80 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "ThreadPool.h"
+// std
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace my_viewer {
+
+// Encodes frames on a thread pool and writes the files in submission order.
+// Pixel buffers come from a pool, so steady capture does not allocate.
+class FrameWriter
+{
+ public:
+  struct Image
+  {
+    int width{0};
+    int height{0};
+    // RGBA, 4 bytes per texel, or 4 floats when isFloat
+    bool isFloat{false};
+    std::vector<uint8_t> pixels;
+
+    size_t rowBytes() const;
+  };
+
+  FrameWriter(ThreadPool &pool = ThreadPool::global());
+  // waits for every frame still being written
+  ~FrameWriter();
+
+  FrameWriter(const FrameWriter &) = delete;
+  FrameWriter &operator=(const FrameWriter &) = delete;
+
+  // an image with room for width x height texels, contents are undefined
+  Image acquire(int width, int height, bool isFloat);
+
+  // Byte images are written as PNG and float images as EXR (Radiance HDR on
+  // Windows, where tinyexr is not built). The extension is appended to
+  // baseName, the full file name is returned.
+  std::string write(Image image, const std::string &baseName);
+
+  // frames submitted but not yet on disk
+  int pending() const;
+  void wait();
+
+ private:
+  struct Encoded
+  {
+    std::string fileName;
+    std::vector<uint8_t> bytes;
+  };
+
+  void encode(uint64_t sequence, Image &image, std::string fileName);
+  void finish(uint64_t sequence, Encoded encoded);
+  void recycle(std::vector<uint8_t> pixels);
+
+  ThreadPool &m_pool;
+
+  std::mutex m_poolMutex;
+  std::vector<std::vector<uint8_t>> m_buffers;
+
+  // encoded frames wait here until all frames submitted before them are
+  // written, the file writes themselves happen under m_writeMutex
+  std::mutex m_writeMutex;
+  std::map<uint64_t, Encoded> m_encoded;
+  uint64_t m_nextSequence{0};
+  uint64_t m_nextToWrite{0};
+
+  std::atomic<int> m_pending{0};
+  std::condition_variable m_drained;
+};
+
+} // namespace my_viewer
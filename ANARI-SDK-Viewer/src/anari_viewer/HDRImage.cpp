@@ -2,7 +2,37 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#if _WIN32
+#include <Windows.h>
+#undef min
+#undef max
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define HDR_IMAGE_SSE 1
+#endif
+// F16C is compiled for this function only and picked at run time, builds do
+// not assume the CPU has it
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define HDR_IMAGE_F16C 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define HDR_IMAGE_F16C_TARGET
+#else
+#define HDR_IMAGE_F16C_TARGET __attribute__((target("avx,f16c")))
+#endif
+#endif
 
 #define STB_IMAGE_IMPLEMENTATION 1
 #define TINYEXR_IMPLEMENTATION 1
@@ -13,45 +43,158 @@
 #endif
 
 #include "HDRImage.h"
+#include "ThreadPool.h"
 
 namespace my_viewer::importers {
 
-bool HDRImage::load(std::string fileName)
+struct CacheHeader
 {
-  if (fileName.size() < 4)
-    return false;
+  char magic[4];
+  uint32_t version;
+  uint64_t key;
+  uint32_t width;
+  uint32_t height;
+  uint64_t pixelOffset;
+  uint64_t fileSize;
+};
+
+static constexpr char CACHE_MAGIC[4] = {'H', 'D', 'R', 'C'};
+static constexpr uint32_t CACHE_VERSION = 2;
+// the source file is identified by its size, time and leading bytes
+static constexpr size_t KEY_PREFIX_BYTES = size_t(64) << 10;
+
+static uint64_t alignUp(uint64_t offset)
+{
+  return (offset + 63) & ~uint64_t(63);
+}
+
+static uint64_t fnv1a(const void *data, size_t size, uint64_t hash)
+{
+  for (size_t i = 0; i < size; i++) {
+    hash ^= ((const uint8_t *)data)[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// read-only mapping of a whole file, unmapped with the last reference
+static std::shared_ptr<const void> mapFile(
+    const std::string &fileName, size_t &size)
+{
+  size = 0;
+#if _WIN32
+  HANDLE file = CreateFileA(fileName.c_str(),
+      GENERIC_READ,
+      FILE_SHARE_READ,
+      nullptr,
+      OPEN_EXISTING,
+      FILE_ATTRIBUTE_NORMAL,
+      nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return {};
+
+  LARGE_INTEGER fileSize;
+  HANDLE mapping = nullptr;
+  if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (mapping == nullptr)
+    return {};
+
+  const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (view == nullptr)
+    return {};
+
+  size = size_t(fileSize.QuadPart);
+  return std::shared_ptr<const void>(
+      view, [](const void *v) { UnmapViewOfFile(v); });
+#else
+  const int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    return {};
+
+  struct stat info;
+  void *view = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && info.st_size > 0)
+    view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (view == MAP_FAILED)
+    return {};
+
+  const size_t mappedSize = size_t(info.st_size);
+  size = mappedSize;
+  return std::shared_ptr<const void>(
+      view, [mappedSize](const void *v) { munmap((void *)v, mappedSize); });
+#endif
+}
+
+std::string HDRImage::extensionOf(const std::string &fileName)
+{
+  const char *dot = strrchr(fileName.c_str(), '.');
+  if (fileName.size() < 4 || dot == nullptr)
+    return {};
 
   // check the extension
-  std::string extension = std::string(strrchr(fileName.c_str(), '.'));
+  std::string extension = std::string(dot);
   std::transform(extension.data(),
       extension.data() + extension.size(),
       std::addressof(extension[0]),
       [](unsigned char c) { return std::tolower(c); });
 
   if (extension != ".hdr" && extension != ".exr")
+    return {};
+
+  return extension;
+}
+
+bool HDRImage::load(std::string fileName)
+{
+  std::string extension = extensionOf(fileName);
+  if (extension.empty())
+    return false;
+
+  std::ifstream file(fileName, std::ios::binary);
+  if (!file)
+    return false;
+
+  std::vector<unsigned char> fileData(
+      (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  return load(fileData, extension);
+}
+
+bool HDRImage::load(
+    const std::vector<unsigned char> &fileData, std::string extension)
+{
+  if (fileData.empty())
     return false;
 
   if (extension == ".hdr") {
     int w, h, n;
-    float *imgData = stbi_loadf(fileName.c_str(), &w, &h, &n, STBI_rgb);
+    float *imgData = stbi_loadf_from_memory(
+        fileData.data(), int(fileData.size()), &w, &h, &n, STBI_rgb);
+    if (imgData == nullptr)
+      return false;
+    // stb converted to the requested number of components
+    n = STBI_rgb;
     width = w;
     height = h;
     numComponents = n;
-    pixel.resize(w * h * n);
-    memcpy(pixel.data(), imgData, w * h * n * sizeof(float));
-    stbi_image_free(imgData);
+    pixel = std::shared_ptr<float>(imgData, stbi_image_free);
     return width > 0 && height > 0
         && (numComponents == 3 || numComponents == 4);
 #ifdef _WIN32
   }
 #else
-  } else {
+  } else if (extension == ".exr") {
     int w, h, n;
     float *imgData;
     const char *err;
-    int ret = LoadEXR(&imgData, &w, &h, fileName.c_str(), &err);
+    int ret = LoadEXRFromMemory(
+        &imgData, &w, &h, fileData.data(), fileData.size(), &err);
     if (ret != 0) {
       printf("Error loading EXR: %s\n", err);
+      FreeEXRErrorMessage(err);
       return false;
     }
     n = 4;
@@ -59,8 +202,7 @@ bool HDRImage::load(std::string fileName)
     width = w;
     height = h;
     numComponents = n;
-    pixel.resize(w * h * n);
-    memcpy(pixel.data(), imgData, w * h * n * sizeof(float));
+    pixel = std::shared_ptr<float>(imgData, free);
     return width > 0 && height > 0
         && (numComponents == 3 || numComponents == 4);
   }
@@ -69,4 +211,314 @@ bool HDRImage::load(std::string fileName)
   return false;
 }
 
+std::string HDRImage::cachePathOf(const std::string &fileName)
+{
+  return fileName + ".cache";
+}
+
+uint64_t HDRImage::fileKey(const std::string &fileName)
+{
+  std::error_code error;
+  const uint64_t size = std::filesystem::file_size(fileName, error);
+  if (error)
+    return 0;
+  const int64_t time =
+      std::filesystem::last_write_time(fileName, error).time_since_epoch()
+          .count();
+  if (error)
+    return 0;
+
+  std::vector<char> prefix(std::min<uint64_t>(size, KEY_PREFIX_BYTES));
+  std::ifstream file(fileName, std::ios::binary);
+  if (!file.read(prefix.data(), prefix.size()))
+    return 0;
+
+  uint64_t hash = 14695981039346656037ull;
+  hash = fnv1a(&size, sizeof(size), hash);
+  hash = fnv1a(&time, sizeof(time), hash);
+  hash = fnv1a(prefix.data(), prefix.size(), hash);
+  return hash;
+}
+
+bool HDRImage::loadCache(const std::string &cacheFile, uint64_t key)
+{
+  size_t size = 0;
+  auto mapping = mapFile(cacheFile, size);
+  if (!mapping || size < sizeof(CacheHeader))
+    return false;
+
+  const auto *base = (const uint8_t *)mapping.get();
+  CacheHeader header;
+  memcpy(&header, base, sizeof(header));
+
+  if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+      || header.version != CACHE_VERSION || header.key != key
+      || header.fileSize != size || header.width == 0 || header.height == 0
+      || header.pixelOffset + uint64_t(header.width) * header.height * 12
+          > size)
+    return false;
+
+  // the texels are only read, the mapping is private and never written
+  width = header.width;
+  height = header.height;
+  numComponents = 3;
+  pixel = std::shared_ptr<float>(
+      mapping, (float *)(base + header.pixelOffset));
+  return true;
+}
+
+bool HDRImage::writeCache(const std::string &cacheFile, uint64_t key) const
+{
+  if (!pixel || key == 0 || (numComponents != 3 && numComponents != 4))
+    return false;
+
+  const uint64_t texels = uint64_t(width) * height;
+
+  CacheHeader header = {};
+  memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.version = CACHE_VERSION;
+  header.key = key;
+  header.width = width;
+  header.height = height;
+  header.pixelOffset = alignUp(sizeof(header));
+  header.fileSize = header.pixelOffset + texels * 12;
+
+  // written under a temporary name so a partial file is never picked up
+  const std::string tmpFile = cacheFile + ".tmp";
+  {
+    std::ofstream out(tmpFile, std::ios::binary | std::ios::trunc);
+    if (!out)
+      return false;
+
+    auto seek = [&](uint64_t offset) {
+      static const char zeros[64] = {};
+      out.write(zeros, offset - uint64_t(out.tellp()));
+    };
+
+    out.write((const char *)&header, sizeof(header));
+
+    seek(header.pixelOffset);
+    if (numComponents == 3)
+      out.write((const char *)pixel.get(), texels * 12);
+    else {
+      std::vector<float> row(size_t(width) * 3);
+      for (unsigned y = 0; y < height; y++) {
+        const float *src = pixel.get() + size_t(y) * width * 4;
+        for (unsigned x = 0; x < width; x++) {
+          row[3 * x + 0] = src[4 * x + 0];
+          row[3 * x + 1] = src[4 * x + 1];
+          row[3 * x + 2] = src[4 * x + 2];
+        }
+        out.write((const char *)row.data(), row.size() * 4);
+      }
+    }
+
+    if (!out)
+      return false;
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tmpFile, cacheFile, error);
+  if (error) {
+    std::filesystem::remove(tmpFile, error);
+    return false;
+  }
+  return true;
+}
+
+static HDRImage halve(const HDRImage &src)
+{
+  HDRImage level;
+  level.width = src.width / 2;
+  level.height = src.height / 2;
+  level.numComponents = 3;
+  level.pixel =
+      std::shared_ptr<float>(new float[size_t(level.width) * level.height * 3],
+          std::default_delete<float[]>());
+
+  const unsigned n = src.numComponents;
+  const size_t srcRow = size_t(src.width) * n;
+  ThreadPool::global().parallelFor(0, level.height, [&](size_t y) {
+    const float *row0 = src.pixel.get() + 2 * y * srcRow;
+    const float *row1 = row0 + srcRow;
+    float *dst = level.pixel.get() + y * level.width * 3;
+    for (unsigned x = 0; x < level.width; x++) {
+      for (unsigned c = 0; c < 3; c++) {
+        dst[3 * x + c] = 0.25f
+            * (row0[2 * x * n + c] + row0[(2 * x + 1) * n + c]
+                + row1[2 * x * n + c] + row1[(2 * x + 1) * n + c]);
+      }
+    }
+  });
+
+  return level;
+}
+
+unsigned HDRImage::halvings() const
+{
+  unsigned n = 0;
+  for (unsigned w = width, h = height; w > 1 && h > 1; w /= 2, h /= 2)
+    n++;
+  return n;
+}
+
+HDRImage HDRImage::halved(unsigned n) const
+{
+  if (!pixel || (numComponents != 3 && numComponents != 4))
+    return *this;
+
+  // every step halves the one before, which is dropped right after
+  HDRImage image = *this;
+  for (unsigned i = std::min(n, halvings()); i > 0; i--)
+    image = halve(image);
+  return image;
+}
+
+// round to nearest even, the same result as the hardware conversion
+static uint16_t floatToHalf(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint32_t sign = (bits >> 16) & 0x8000;
+  bits &= 0x7fffffff;
+
+  // too large for half, infinity or NaN
+  if (bits >= 0x47800000)
+    return uint16_t(sign | (bits > 0x7f800000 ? 0x7e00 : 0x7c00));
+
+  // subnormal half or zero, let the float adder do the rounding
+  if (bits < 0x38800000) {
+    float magnitude;
+    memcpy(&magnitude, &bits, sizeof(bits));
+    magnitude += 0.5f;
+    memcpy(&bits, &magnitude, sizeof(bits));
+    return uint16_t(sign | (bits - 0x3f000000));
+  }
+
+  // rebias the exponent and round the mantissa
+  const uint32_t mantissaOdd = (bits >> 13) & 1;
+  bits += 0xc8000fff + mantissaOdd;
+  return uint16_t(sign | (bits >> 13));
+}
+
+#if HDR_IMAGE_F16C
+static bool hasF16C()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 1);
+  // the OS has to save the AVX registers, the conversion uses them
+  const bool osxsave = info[2] & (1 << 27);
+  const bool avx = info[2] & (1 << 28);
+  const bool f16c = info[2] & (1 << 29);
+  return osxsave && avx && f16c && (_xgetbv(0) & 6) == 6;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+#endif
+}
+
+// converts whole groups of 8, returns how many values it converted
+HDR_IMAGE_F16C_TARGET static size_t floatToHalfF16C(
+    const float *src, uint16_t *dst, size_t count)
+{
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m128i half =
+        _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128((__m128i *)(dst + i), half);
+  }
+  return i;
+}
+#endif
+
+void HDRImage::floatToHalf(const float *src, uint16_t *dst, size_t count)
+{
+  size_t i = 0;
+#if HDR_IMAGE_F16C
+  static const bool f16c = hasF16C();
+  if (f16c)
+    i = floatToHalfF16C(src, dst, count);
+#endif
+  for (; i < count; i++)
+    dst[i] = importers::floatToHalf(src[i]);
+}
+
+std::shared_ptr<uint16_t> HDRImage::toHalf() const
+{
+  if (!pixel || (numComponents != 3 && numComponents != 4))
+    return {};
+
+  const size_t rowSize = size_t(width) * 3;
+  std::shared_ptr<uint16_t> half(
+      new uint16_t[rowSize * height], std::default_delete<uint16_t[]>());
+
+  ThreadPool::global().parallelFor(0, height, [&](size_t y) {
+    uint16_t *dst = half.get() + y * rowSize;
+    if (numComponents == 3) {
+      floatToHalf(pixel.get() + y * rowSize, dst, rowSize);
+      return;
+    }
+    // the whole RGBA row converts in wide chunks, alpha is dropped after
+    thread_local std::vector<uint16_t> rgba;
+    rgba.resize(size_t(width) * 4);
+    floatToHalf(pixel.get() + y * width * 4, rgba.data(), rgba.size());
+    for (unsigned x = 0; x < width; x++) {
+      dst[3 * x + 0] = rgba[4 * x + 0];
+      dst[3 * x + 1] = rgba[4 * x + 1];
+      dst[3 * x + 2] = rgba[4 * x + 2];
+    }
+  });
+
+  return half;
+}
+
+void HDRImage::dropAlpha()
+{
+  if (numComponents != 4 || !pixel)
+    return;
+
+  float *data = pixel.get();
+  const size_t count = size_t(width) * height;
+  size_t i = 0;
+
+  // every store lands at or before the pixels already loaded, so packing
+  // front to back never overwrites input that is still to be read
+#if HDR_IMAGE_SSE
+  for (; i + 4 <= count; i += 4) {
+    const float *src = data + 4 * i;
+    float *dst = data + 3 * i;
+    const __m128 p0 = _mm_loadu_ps(src); // r0 g0 b0 a0
+    const __m128 p1 = _mm_loadu_ps(src + 4); // r1 g1 b1 a1
+    const __m128 p2 = _mm_loadu_ps(src + 8); // r2 g2 b2 a2
+    const __m128 p3 = _mm_loadu_ps(src + 12); // r3 g3 b3 a3
+
+    // r0 g0 b0 r1
+    const __m128 r1 = _mm_shuffle_ps(p1, p1, _MM_SHUFFLE(0, 0, 0, 0));
+    const __m128 out0 =
+        _mm_shuffle_ps(p0, _mm_unpacklo_ps(_mm_movehl_ps(p0, p0), r1),
+            _MM_SHUFFLE(3, 0, 1, 0));
+    // g1 b1 r2 g2
+    const __m128 out1 = _mm_shuffle_ps(p1, p2, _MM_SHUFFLE(1, 0, 2, 1));
+    // b2 r3 g3 b3
+    const __m128 out2 = _mm_shuffle_ps(
+        _mm_shuffle_ps(p2, p3, _MM_SHUFFLE(0, 0, 2, 2)),
+        p3,
+        _MM_SHUFFLE(2, 1, 2, 0));
+
+    _mm_storeu_ps(dst, out0);
+    _mm_storeu_ps(dst + 4, out1);
+    _mm_storeu_ps(dst + 8, out2);
+  }
+#endif
+
+  for (; i < count; i++) {
+    data[3 * i + 0] = data[4 * i + 0];
+    data[3 * i + 1] = data[4 * i + 1];
+    data[3 * i + 2] = data[4 * i + 2];
+  }
+
+  numComponents = 3;
+}
+
 } // namespace anari_viewer::importers
@@ -4,6 +4,8 @@
 #pragma once
 
 // std
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -12,11 +14,35 @@ namespace my_viewer::importers {
 struct HDRImage
 {
   bool load(std::string fileName);
+  // decodes a whole .hdr or .exr file already read into memory
+  bool load(const std::vector<unsigned char> &fileData, std::string extension);
 
-  unsigned width;
-  unsigned height;
-  unsigned numComponents;
-  std::vector<float> pixel;
+  // lower case extension including the dot, empty if it is not .hdr or .exr
+  static std::string extensionOf(const std::string &fileName);
+
+  // packs RGBA to RGB in place, the buffer is not reallocated
+  void dropAlpha();
+
+  // Preprocessed cache next to the source file: RGB texels memory mapped on
+  // load and tied to the source through fileKey()
+  static std::string cachePathOf(const std::string &fileName);
+  static uint64_t fileKey(const std::string &fileName);
+  bool loadCache(const std::string &cacheFile, uint64_t key);
+  bool writeCache(const std::string &cacheFile, uint64_t key) const;
+
+  // how often the image can be halved, down to a single row or column
+  unsigned halvings() const;
+  // the image 2x2 box filtered n times, built on demand; 0 shares the texels
+  HDRImage halved(unsigned n) const;
+  // RGB texels as IEEE half floats, alpha is dropped
+  std::shared_ptr<uint16_t> toHalf() const;
+  static void floatToHalf(const float *src, uint16_t *dst, size_t count);
+
+  unsigned width{0};
+  unsigned height{0};
+  unsigned numComponents{0};
+  // the decoder's own buffer, freed with the decoder's deallocator
+  std::shared_ptr<float> pixel;
 };
 
 } // namespace anari_viewer::importers
@@ -0,0 +1,202 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#include "HDRLoader.h"
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+#include "common.h"
+
+namespace my_viewer::importers {
+
+// progress is reported per chunk while reading the file
+static constexpr size_t READ_CHUNK_BYTES = size_t(4) << 20;
+// share of the progress bar for each step, decoding reports no progress
+static constexpr float READ_SHARE = 0.5f;
+static constexpr float DECODE_SHARE = 0.4f;
+
+const std::string &HDRLoad::fileName() const
+{
+  return m_fileName;
+}
+
+float HDRLoad::progress() const
+{
+  return m_progress;
+}
+
+bool HDRLoad::ready() const
+{
+  return m_result.wait_for(std::chrono::seconds(0))
+      == std::future_status::ready;
+}
+
+void HDRLoad::cancel()
+{
+  m_cancelled = true;
+}
+
+bool HDRLoad::cancelled() const
+{
+  return m_cancelled;
+}
+
+std::optional<HDRImage> HDRLoad::take()
+{
+  auto image = m_result.get();
+  if (m_cancelled)
+    return {};
+  return image;
+}
+
+std::optional<HDRImage> HDRLoad::run()
+{
+  TRACE_SCOPE("load_hdri");
+
+  const std::string extension = HDRImage::extensionOf(m_fileName);
+  if (extension.empty()) {
+    printf("Error loading HDR image, unsupported file: %s\n",
+        m_fileName.c_str());
+    return {};
+  }
+
+  // a preprocessed copy from an earlier load maps in without decoding
+  const std::string cacheFile = HDRImage::cachePathOf(m_fileName);
+  const uint64_t key = HDRImage::fileKey(m_fileName);
+  HDRImage image;
+  if (key != 0 && image.loadCache(cacheFile, key)) {
+    m_progress = 1.f;
+    return image;
+  }
+
+  std::ifstream file(m_fileName, std::ios::binary | std::ios::ate);
+  if (!file) {
+    printf("Error loading HDR image, cannot open: %s\n", m_fileName.c_str());
+    return {};
+  }
+
+  std::vector<unsigned char> fileData(size_t(file.tellg()));
+  file.seekg(0);
+  for (size_t offset = 0; offset < fileData.size();) {
+    if (m_cancelled)
+      return {};
+    const size_t chunk = std::min(READ_CHUNK_BYTES, fileData.size() - offset);
+    if (!file.read((char *)fileData.data() + offset, chunk))
+      return {};
+    offset += chunk;
+    m_progress = READ_SHARE * offset / fileData.size();
+  }
+
+  if (m_cancelled)
+    return {};
+
+  if (!image.load(fileData, extension)) {
+    printf("Error loading HDR image: %s\n", m_fileName.c_str());
+    return {};
+  }
+  fileData = {};
+  m_progress = READ_SHARE + DECODE_SHARE;
+
+  if (image.numComponents == 4 && !m_keepAlpha)
+    image.dropAlpha();
+  else if (image.numComponents != 3 && image.numComponents != 4) {
+    printf("Error loading HDR image, unsupported num. components: %u\n",
+        image.numComponents);
+    return {};
+  }
+
+  if (m_cancelled)
+    return {};
+
+  // the cache is written after this load is handed out, it shares the texels
+  if (key != 0) {
+    m_pool->enqueue([image, cacheFile, key]() {
+      TRACE_SCOPE("write_hdri_cache");
+      if (!image.writeCache(cacheFile, key))
+        printf("Could not write HDR image cache: %s\n", cacheFile.c_str());
+    });
+  }
+
+  m_progress = 1.f;
+  return image;
+}
+
+bool HDRPrepare::ready() const
+{
+  return m_result.wait_for(std::chrono::seconds(0))
+      == std::future_status::ready;
+}
+
+void HDRPrepare::cancel()
+{
+  m_cancelled = true;
+}
+
+std::optional<HDRTexels> HDRPrepare::take()
+{
+  auto texels = m_result.get();
+  if (m_cancelled)
+    return {};
+  return texels;
+}
+
+std::optional<HDRTexels> HDRPrepare::run()
+{
+  TRACE_SCOPE("prepare_hdri");
+
+  // the full image is dropped after the first step, the light still has it
+  HDRImage image = std::move(m_image);
+  for (unsigned i = std::min(m_halvings, image.halvings()); i > 0; i--) {
+    if (m_cancelled)
+      return {};
+    image = image.halved(1);
+  }
+
+  if (m_cancelled)
+    return {};
+
+  HDRTexels texels;
+  texels.width = image.width;
+  texels.height = image.height;
+  if (m_half) {
+    texels.numComponents = 3;
+    texels.half = true;
+    texels.data = image.toHalf();
+  } else {
+    texels.numComponents = image.numComponents;
+    texels.data = image.pixel;
+  }
+
+  if (!texels.data)
+    return {};
+  return texels;
+}
+
+HDRLoader::HDRLoader(ThreadPool &pool) : m_pool(pool) {}
+
+std::shared_ptr<HDRLoad> HDRLoader::load(std::string fileName, bool keepAlpha)
+{
+  auto load = std::make_shared<HDRLoad>();
+  load->m_fileName = fileName;
+  load->m_keepAlpha = keepAlpha;
+  load->m_pool = &m_pool;
+  // the task keeps the load alive, dropping a cancelled one is fine
+  load->m_result = m_pool.enqueue([load]() { return load->run(); });
+  return load;
+}
+
+std::shared_ptr<HDRPrepare> HDRLoader::prepare(
+    HDRImage image, unsigned halvings, bool half)
+{
+  auto prepare = std::make_shared<HDRPrepare>();
+  prepare->m_image = std::move(image);
+  prepare->m_halvings = halvings;
+  prepare->m_half = half;
+  prepare->m_result = m_pool.enqueue([prepare]() { return prepare->run(); });
+  return prepare;
+}
+
+} // namespace my_viewer::importers
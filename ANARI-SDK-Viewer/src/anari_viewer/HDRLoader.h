@@ -0,0 +1,98 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "HDRImage.h"
+#include "ThreadPool.h"
+// std
+#include <atomic>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace my_viewer::importers {
+
+// An HDR image being read and decoded in the background
+class HDRLoad
+{
+ public:
+  const std::string &fileName() const;
+  float progress() const;
+  bool ready() const;
+
+  // the decode stops at its next step, take() then returns nothing
+  void cancel();
+  bool cancelled() const;
+
+  // the image with 3 components, or 4 when alpha was kept; empty if it
+  // failed or was cancelled. Call once, after ready()
+  std::optional<HDRImage> take();
+
+ private:
+  friend class HDRLoader;
+
+  std::optional<HDRImage> run();
+
+  std::string m_fileName;
+  bool m_keepAlpha{false};
+  ThreadPool *m_pool{nullptr}; // the loader's, it also writes the cache
+  std::atomic<bool> m_cancelled{false};
+  std::atomic<float> m_progress{0.f};
+  std::future<std::optional<HDRImage>> m_result;
+};
+
+// One resolution and texel format of a decoded image, ready to upload
+struct HDRTexels
+{
+  unsigned width{0};
+  unsigned height{0};
+  unsigned numComponents{0};
+  bool half{false}; // RGB IEEE half floats, floats otherwise
+  std::shared_ptr<void> data;
+};
+
+// Texels being built from a decoded image in the background
+class HDRPrepare
+{
+ public:
+  bool ready() const;
+
+  // the work stops at its next step, take() then returns nothing
+  void cancel();
+
+  // empty if it was cancelled. Call once, after ready()
+  std::optional<HDRTexels> take();
+
+ private:
+  friend class HDRLoader;
+
+  std::optional<HDRTexels> run();
+
+  HDRImage m_image;
+  unsigned m_halvings{0};
+  bool m_half{false};
+  std::atomic<bool> m_cancelled{false};
+  std::future<std::optional<HDRTexels>> m_result;
+};
+
+// Decodes HDR images on a thread pool, several loads can be in flight at once
+class HDRLoader
+{
+ public:
+  HDRLoader(ThreadPool &pool = ThreadPool::global());
+
+  // keepAlpha skips packing 4 component images down to RGB
+  std::shared_ptr<HDRLoad> load(std::string fileName, bool keepAlpha = false);
+
+  // halves the image n times and converts it to half floats if asked, the
+  // image shares its texels with the job
+  std::shared_ptr<HDRPrepare> prepare(
+      HDRImage image, unsigned halvings, bool half);
+
+ private:
+  ThreadPool &m_pool;
+};
+
+} // namespace my_viewer::importers
@@ -0,0 +1,182 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Reprojector.h"
+#include "ThreadPool.h"
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "common.h"
+
+namespace my_viewer {
+
+using anari::math::float3;
+
+// depth at or beyond this is a miss, treated as infinitely far away
+static constexpr float BACKGROUND_DEPTH = 1e30f;
+// history is clamped to mean +- GAMMA * standard deviation of the new frame
+static constexpr float GAMMA = 1.5f;
+
+// pixel (x, y) covers the screen point (x + 0.5) / width * 2 - 1 along
+// right * halfWidth and the same for y along up, row 0 is the bottom row
+struct Basis
+{
+  float3 eye;
+  float3 dir;
+  float3 right;
+  float3 up;
+  float halfWidth;
+  float halfHeight;
+};
+
+static Basis basisOf(const ReprojectionView &view)
+{
+  Basis b;
+  b.eye = view.eye;
+  b.dir = normalize(view.dir);
+  b.right = normalize(cross(b.dir, view.up));
+  b.up = cross(b.right, b.dir);
+  b.halfHeight = std::tan(0.5f * view.fovy);
+  b.halfWidth = b.halfHeight * view.aspect;
+  return b;
+}
+
+static bool isBackground(float depth)
+{
+  return !(depth < BACKGROUND_DEPTH); // NaN as well
+}
+
+void Reprojector::apply(const ReprojectionView &view,
+    int width,
+    int height,
+    void *color,
+    bool isFloat,
+    const float *depth)
+{
+  TRACE_SCOPE("Reprojector::apply");
+
+  const size_t numPixels = size_t(width) * height;
+  const bool haveHistory = m_valid && width == m_width && height == m_height;
+
+  m_current.resize(numPixels * 4);
+  m_nextHistory.resize(numPixels * 4);
+  m_nextDepth.resize(numPixels);
+  m_nextCount.resize(numPixels);
+
+  auto &pool = ThreadPool::global();
+
+  // all math happens on float RGBA, byte frames are blended in sRGB space
+  pool.parallelFor(0, height, [&](size_t y) {
+    const size_t begin = y * width * 4;
+    const size_t end = begin + size_t(width) * 4;
+    if (isFloat) {
+      const float *src = static_cast<const float *>(color);
+      std::copy(src + begin, src + end, m_current.begin() + begin);
+    } else {
+      const uint8_t *src = static_cast<const uint8_t *>(color);
+      for (size_t k = begin; k < end; k++)
+        m_current[k] = src[k] * (1.f / 255.f);
+    }
+  });
+
+  const Basis cur = basisOf(view);
+  const Basis prev = basisOf(m_view);
+
+  // index of the pixel showing the same surface in the previous frame, or -1
+  auto previousPixel = [&](int x, int y, float d) -> ptrdiff_t {
+    const float sx = ((x + 0.5f) / width * 2.f - 1.f) * cur.halfWidth;
+    const float sy = ((y + 0.5f) / height * 2.f - 1.f) * cur.halfHeight;
+    const float3 ray = normalize(cur.dir + sx * cur.right + sy * cur.up);
+
+    // the background only rotates with the camera, it never moves
+    const bool background = isBackground(d);
+    const float3 v = background ? ray : cur.eye + d * ray - prev.eye;
+    const float z = dot(v, prev.dir);
+    if (z <= 0.f)
+      return -1;
+
+    const float px = dot(v, prev.right) / (z * prev.halfWidth);
+    const float py = dot(v, prev.up) / (z * prev.halfHeight);
+    const int qx = int(std::floor((px + 1.f) * 0.5f * width));
+    const int qy = int(std::floor((py + 1.f) * 0.5f * height));
+    if (qx < 0 || qy < 0 || qx >= width || qy >= height)
+      return -1;
+
+    const size_t j = size_t(qy) * width + qx;
+    const float pd = m_depth[j];
+    const bool sameSurface = background
+        ? isBackground(pd)
+        : !isBackground(pd) && std::abs(pd - length(v)) <= depthTolerance * pd;
+    return sameSurface ? ptrdiff_t(j) : -1;
+  };
+
+  pool.parallelFor(0, height, [&](size_t y) {
+    for (int x = 0; x < width; x++) {
+      const size_t i = y * width + x;
+      const float *c = &m_current[i * 4];
+      float out[4] = {c[0], c[1], c[2], c[3]};
+      int count = 1;
+
+      const ptrdiff_t j = haveHistory ? previousPixel(x, int(y), depth[i]) : -1;
+      if (j >= 0) {
+        float mean[4] = {};
+        float meanSq[4] = {};
+        int n = 0;
+        const int yBegin = std::max(0, int(y) - 1);
+        const int yEnd = std::min(height - 1, int(y) + 1);
+        const int xBegin = std::max(0, x - 1);
+        const int xEnd = std::min(width - 1, x + 1);
+        for (int ny = yBegin; ny <= yEnd; ny++) {
+          for (int nx = xBegin; nx <= xEnd; nx++) {
+            const float *nc = &m_current[(size_t(ny) * width + nx) * 4];
+            for (int k = 0; k < 4; k++) {
+              mean[k] += nc[k];
+              meanSq[k] += nc[k] * nc[k];
+            }
+            n++;
+          }
+        }
+
+        count = std::min(int(m_count[j]) + 1, maxHistory);
+        const float weight = 1.f / count;
+        for (int k = 0; k < 4; k++) {
+          const float m = mean[k] / n;
+          const float sd = std::sqrt(std::max(meanSq[k] / n - m * m, 0.f));
+          const float h =
+              std::clamp(m_history[j * 4 + k], m - GAMMA * sd, m + GAMMA * sd);
+          out[k] = h + (c[k] - h) * weight;
+        }
+      }
+
+      std::copy(out, out + 4, &m_nextHistory[i * 4]);
+      m_nextDepth[i] = depth[i];
+      m_nextCount[i] = uint8_t(count);
+
+      if (isFloat) {
+        std::copy(out, out + 4, static_cast<float *>(color) + i * 4);
+      } else {
+        uint8_t *dst = static_cast<uint8_t *>(color) + i * 4;
+        for (int k = 0; k < 4; k++)
+          dst[k] = uint8_t(std::clamp(out[k], 0.f, 1.f) * 255.f + 0.5f);
+      }
+    }
+  });
+
+  std::swap(m_history, m_nextHistory);
+  std::swap(m_depth, m_nextDepth);
+  std::swap(m_count, m_nextCount);
+
+  m_view = view;
+  m_width = width;
+  m_height = height;
+  m_valid = true;
+}
+
+void Reprojector::reset()
+{
+  m_valid = false;
+}
+
+} // namespace my_viewer
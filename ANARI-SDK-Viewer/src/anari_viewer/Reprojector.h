@@ -0,0 +1,63 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <anari/anari_cpp/ext/linalg.h>
+// std
+#include <cstdint>
+#include <vector>
+
+namespace my_viewer {
+
+// Perspective camera a frame was rendered with
+struct ReprojectionView
+{
+  anari::math::float3 eye{0.f};
+  anari::math::float3 dir{0.f, 0.f, 1.f};
+  anari::math::float3 up{0.f, 1.f, 0.f};
+  float fovy{0.7f}; // radians
+  float aspect{1.f};
+};
+
+// Blends every new frame with the previous result warped into the new view.
+// Each pixel is moved to world space with its depth, projected into the
+// previous view and accepted as history when the depth found there agrees.
+// Accepted history is clamped to the local color distribution of the new
+// frame, so disocclusions and shading changes fade out instead of ghosting.
+class Reprojector
+{
+ public:
+  // color is RGBA8 or, with isFloat, RGBA32F and receives the blended
+  // result. depth is the distance from the eye along the primary ray,
+  // anything at or beyond 1e30 is background.
+  void apply(const ReprojectionView &view,
+      int width,
+      int height,
+      void *color,
+      bool isFloat,
+      const float *depth);
+
+  // the next frame starts a new history
+  void reset();
+
+  int maxHistory{8}; // frames blended at most, bounds the blend weight
+  float depthTolerance{0.05f}; // relative depth difference still accepted
+
+ private:
+  ReprojectionView m_view;
+  int m_width{0};
+  int m_height{0};
+  bool m_valid{false};
+
+  // RGBA history, depth and number of frames blended into each pixel
+  std::vector<float> m_history;
+  std::vector<float> m_depth;
+  std::vector<uint8_t> m_count;
+  std::vector<float> m_nextHistory;
+  std::vector<float> m_nextDepth;
+  std::vector<uint8_t> m_nextCount;
+  std::vector<float> m_current;
+};
+
+} // namespace my_viewer
@@ -0,0 +1,205 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#include "SceneBuilder.h"
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+#if _WIN32
+#include <Windows.h>
+#include <psapi.h>
+#undef min
+#undef max
+#elif __APPLE__
+#include <mach/mach.h>
+#elif __linux__
+#include <malloc.h>
+#include <unistd.h>
+#endif
+
+#include "common.h"
+
+namespace my_viewer {
+
+// scenes smaller than this still count, so the cache cannot grow unbounded
+static constexpr size_t MIN_SCENE_BYTES = size_t(1) << 20;
+
+#if defined(__GLIBC__) \
+    && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define HAVE_MALLINFO2 1
+#endif
+
+// Host memory in use by the process. The glibc heap reports the bytes handed
+// out, which stays right when a build reuses pages freed by an evicted scene;
+// elsewhere the resident set is the best there is.
+static size_t hostBytes()
+{
+#if HAVE_MALLINFO2
+  const struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+#elif _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return counters.WorkingSetSize;
+#elif __APPLE__
+  mach_task_basic_info_data_t info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(),
+          MACH_TASK_BASIC_INFO,
+          reinterpret_cast<task_info_t>(&info),
+          &count)
+      == KERN_SUCCESS)
+    return info.resident_size;
+#elif __linux__
+  long pages = 0, resident = 0;
+  if (FILE *statm = fopen("/proc/self/statm", "r")) {
+    if (fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+      resident = 0;
+    fclose(statm);
+  }
+  return size_t(resident) * size_t(sysconf(_SC_PAGESIZE));
+#endif
+  return 0;
+}
+
+void release(BuiltScene &s)
+{
+  for (auto scene : s.scenes)
+    anari::scenes::release(scene);
+  s.scenes.clear();
+  s.worlds.clear();
+}
+
+SceneBuilder::SceneBuilder(std::vector<anari::Device> devices)
+    : m_devices(devices)
+{}
+
+SceneBuilder::~SceneBuilder()
+{
+  if (m_current)
+    m_stale.push_back(m_current);
+
+  for (auto &job : m_stale) {
+    job->cancelled = true;
+    auto result = job->result.get();
+    if (result)
+      release(*result);
+  }
+}
+
+void SceneBuilder::request(const char *category, const char *scene)
+{
+  cancel();
+
+  auto job = std::make_shared<Job>();
+  job->category = category;
+  job->scene = scene;
+  job->steps = 2 * int(m_devices.size());
+  job->result = m_worker.enqueue([this, job]() { return build(*job); });
+
+  m_current = job;
+}
+
+void SceneBuilder::cancel()
+{
+  if (m_current) {
+    m_current->cancelled = true;
+    m_stale.push_back(m_current);
+    m_current.reset();
+  }
+}
+
+std::optional<BuiltScene> SceneBuilder::poll()
+{
+  auto isReady = [](const std::shared_ptr<Job> &job) {
+    return job->result.wait_for(std::chrono::seconds(0))
+        == std::future_status::ready;
+  };
+
+  // a build may finish right before it gets superseded, drop it here
+  for (auto it = m_stale.begin(); it != m_stale.end();) {
+    if (isReady(*it)) {
+      auto result = (*it)->result.get();
+      if (result)
+        release(*result);
+      it = m_stale.erase(it);
+    } else
+      ++it;
+  }
+
+  if (!m_current || !isReady(m_current))
+    return {};
+
+  auto result = m_current->result.get();
+  m_current.reset();
+  return result;
+}
+
+bool SceneBuilder::busy() const
+{
+  return m_current != nullptr;
+}
+
+float SceneBuilder::progress() const
+{
+  if (!m_current)
+    return 1.f;
+  return m_current->stepsDone / float(m_current->steps);
+}
+
+const char *SceneBuilder::sceneName() const
+{
+  return m_current ? m_current->scene.c_str() : "";
+}
+
+std::optional<BuiltScene> SceneBuilder::build(Job &job) const
+{
+  if (job.cancelled)
+    return {};
+
+  TRACE_SCOPE("create_scene");
+
+  BuiltScene retval;
+  retval.category = job.category;
+  retval.name = job.scene;
+
+  // a rough estimate: allocations of the UI thread during the build are
+  // counted too, devices holding scene data off the host do not show up
+  const size_t hostBefore = hostBytes();
+
+  // every device gets its own instance of the scene
+  try {
+    for (auto d : m_devices) {
+      if (job.cancelled)
+        break;
+      retval.scenes.push_back(anari::scenes::createScene(
+          d, job.category.c_str(), job.scene.c_str()));
+      job.stepsDone++;
+      anari::scenes::commit(retval.scenes.back());
+      job.stepsDone++;
+    }
+  } catch (const std::runtime_error &e) {
+    printf("%s\n", e.what());
+    release(retval);
+    return {};
+  }
+
+  if (job.cancelled) {
+    release(retval);
+    return {};
+  }
+
+  for (auto s : retval.scenes)
+    retval.worlds.push_back(anari::scenes::getWorld(s));
+
+  const size_t hostAfter = hostBytes();
+  retval.bytes = hostAfter > hostBefore ? hostAfter - hostBefore : 0;
+  retval.bytes = std::max(retval.bytes, MIN_SCENE_BYTES);
+
+  return retval;
+}
+
+} // namespace my_viewer
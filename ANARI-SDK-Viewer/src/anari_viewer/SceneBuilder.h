@@ -0,0 +1,70 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "ThreadPool.h"
+// anari
+#include <anari_test_scenes.h>
+// std
+#include <atomic>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace my_viewer {
+
+// One committed instance of a test scene per device
+struct BuiltScene
+{
+  std::string category;
+  std::string name;
+  std::vector<anari::scenes::SceneHandle> scenes;
+  std::vector<anari::World> worlds;
+  size_t bytes{0}; // estimated host memory held by the scenes
+};
+
+void release(BuiltScene &s);
+
+// Builds test scenes on a worker thread. Only the most recent request is
+// ever handed out, older builds are cancelled and their scenes released.
+class SceneBuilder
+{
+ public:
+  SceneBuilder(std::vector<anari::Device> devices);
+  ~SceneBuilder();
+
+  void request(const char *category, const char *scene);
+  void cancel();
+
+  // the result of the latest request, once, when it is ready
+  std::optional<BuiltScene> poll();
+
+  bool busy() const;
+  float progress() const;
+  const char *sceneName() const;
+
+ private:
+  struct Job
+  {
+    std::string category;
+    std::string scene;
+    std::atomic<bool> cancelled{false};
+    std::atomic<int> stepsDone{0};
+    int steps{1};
+    std::future<std::optional<BuiltScene>> result;
+  };
+
+  std::optional<BuiltScene> build(Job &job) const;
+
+  std::vector<anari::Device> m_devices;
+  std::shared_ptr<Job> m_current;
+  std::vector<std::shared_ptr<Job>> m_stale;
+
+  // builds run one after another, never two on the same device at once
+  ThreadPool m_worker{1};
+};
+
+} // namespace my_viewer
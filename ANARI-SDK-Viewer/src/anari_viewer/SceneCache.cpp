@@ -0,0 +1,122 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#include "SceneCache.h"
+// std
+#include <cstdio>
+
+namespace my_viewer {
+
+SceneCache::SceneCache(size_t budgetBytes, size_t maxEntries)
+    : m_budget(budgetBytes), m_maxEntries(maxEntries)
+{}
+
+SceneCache::~SceneCache()
+{
+  for (auto &e : m_entries)
+    release(e.scene);
+}
+
+std::string SceneCache::key(
+    const std::string &category, const std::string &scene, size_t hash)
+{
+  char hex[17];
+  snprintf(hex, sizeof(hex), "%016zx", hash);
+  return category + "/" + scene + "#" + hex;
+}
+
+BuiltScene *SceneCache::acquire(const std::string &key)
+{
+  auto found = m_index.find(key);
+  if (found == m_index.end())
+    return nullptr;
+
+  m_entries.splice(m_entries.begin(), m_entries, found->second);
+  m_inUse = key;
+  return &found->second->scene;
+}
+
+BuiltScene &SceneCache::insert(const std::string &key, BuiltScene scene)
+{
+  auto found = m_index.find(key);
+  if (found != m_index.end()) {
+    m_usage -= found->second->scene.bytes;
+    release(found->second->scene);
+    m_entries.erase(found->second);
+    m_index.erase(found);
+  }
+
+  m_usage += scene.bytes;
+  m_entries.push_front({key, std::move(scene)});
+  m_index[key] = m_entries.begin();
+  m_inUse = key;
+
+  evict();
+
+  return m_entries.front().scene;
+}
+
+void SceneCache::rekeyInUse(size_t parametersHash)
+{
+  auto found = m_index.find(m_inUse);
+  if (found == m_index.end())
+    return;
+
+  const BuiltScene &scene = found->second->scene;
+  const std::string newKey = key(scene.category, scene.name, parametersHash);
+  if (newKey == m_inUse)
+    return;
+
+  // an older entry filed under the new key is superseded
+  auto existing = m_index.find(newKey);
+  if (existing != m_index.end()) {
+    m_usage -= existing->second->scene.bytes;
+    release(existing->second->scene);
+    m_entries.erase(existing->second);
+    m_index.erase(existing);
+  }
+
+  auto entry = found->second;
+  m_index.erase(found);
+  entry->key = newKey;
+  m_index[newKey] = entry;
+  m_inUse = newKey;
+}
+
+size_t SceneCache::budget() const
+{
+  return m_budget;
+}
+
+size_t SceneCache::maxEntries() const
+{
+  return m_maxEntries;
+}
+
+size_t SceneCache::usage() const
+{
+  return m_usage;
+}
+
+size_t SceneCache::size() const
+{
+  return m_entries.size();
+}
+
+void SceneCache::evict()
+{
+  auto it = m_entries.end();
+  while ((m_usage > m_budget || m_entries.size() > m_maxEntries)
+      && it != m_entries.begin()) {
+    --it;
+    if (it->key == m_inUse)
+      continue;
+
+    m_usage -= it->scene.bytes;
+    release(it->scene);
+    m_index.erase(it->key);
+    it = m_entries.erase(it);
+  }
+}
+
+} // namespace my_viewer
@@ -0,0 +1,57 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "SceneBuilder.h"
+// std
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+namespace my_viewer {
+
+// Least recently used cache of committed scenes, it owns every scene handed
+// to it. Entries are keyed by category, scene name and a hash of the scene
+// parameter values. The entry in use is never evicted. Scene sizes are
+// estimates, so the number of entries is capped as well.
+class SceneCache
+{
+ public:
+  SceneCache(size_t budgetBytes, size_t maxEntries);
+  ~SceneCache();
+
+  static std::string key(
+      const std::string &category, const std::string &scene, size_t hash);
+
+  // marks the entry as most recently used and in use
+  BuiltScene *acquire(const std::string &key);
+  BuiltScene &insert(const std::string &key, BuiltScene scene);
+
+  // the in-use scene was changed in place, file it under its new parameters
+  void rekeyInUse(size_t parametersHash);
+
+  size_t budget() const;
+  size_t maxEntries() const;
+  size_t usage() const;
+  size_t size() const;
+
+ private:
+  struct Entry
+  {
+    std::string key;
+    BuiltScene scene;
+  };
+
+  void evict();
+
+  size_t m_budget{0};
+  size_t m_maxEntries{0};
+  size_t m_usage{0};
+  std::list<Entry> m_entries; // most recently used first
+  std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+  std::string m_inUse;
+};
+
+} // namespace my_viewer
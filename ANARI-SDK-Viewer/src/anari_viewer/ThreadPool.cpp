@@ -0,0 +1,70 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#include "ThreadPool.h"
+// std
+#include <algorithm>
+
+namespace my_viewer {
+
+ThreadPool::ThreadPool(unsigned numThreads)
+{
+  if (numThreads == 0)
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (unsigned i = 0; i < numThreads; i++)
+    m_threads.emplace_back([this]() { workerLoop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_condition.notify_all();
+
+  for (auto &t : m_threads)
+    t.join();
+}
+
+size_t ThreadPool::size() const
+{
+  return m_threads.size();
+}
+
+ThreadPool &ThreadPool::global()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+void ThreadPool::push(std::function<void()> task)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push_back(std::move(task));
+  }
+  m_condition.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+  for (;;) {
+    std::function<void()> task;
+
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [&]() { return m_stop || !m_tasks.empty(); });
+      // queued tasks still run on shutdown, their futures may be waited on
+      if (m_tasks.empty())
+        return;
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+
+    task();
+  }
+}
+
+} // namespace my_viewer
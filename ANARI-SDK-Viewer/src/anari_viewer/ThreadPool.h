@@ -0,0 +1,119 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace my_viewer {
+
+class ThreadPool
+{
+ public:
+  // numThreads == 0 uses one thread per hardware thread
+  explicit ThreadPool(unsigned numThreads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  size_t size() const;
+
+  template <typename F>
+  auto enqueue(F &&f) -> std::future<std::invoke_result_t<std::decay_t<F>>>;
+
+  // Calls f(i) for every i in [begin, end) and returns once all calls are
+  // done. The calling thread takes part, so this is safe to use from a task.
+  template <typename F>
+  void parallelFor(size_t begin, size_t end, F &&f);
+
+  // process wide pool for short CPU bound work
+  static ThreadPool &global();
+
+ private:
+  void push(std::function<void()> task);
+  void workerLoop();
+
+  std::vector<std::thread> m_threads;
+  std::deque<std::function<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_stop{false};
+};
+
+// Inlined definitions ////////////////////////////////////////////////////////
+
+template <typename F>
+inline auto ThreadPool::enqueue(F &&f)
+    -> std::future<std::invoke_result_t<std::decay_t<F>>>
+{
+  using R = std::invoke_result_t<std::decay_t<F>>;
+  auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+  auto future = task->get_future();
+  push([task]() { (*task)(); });
+  return future;
+}
+
+template <typename F>
+inline void ThreadPool::parallelFor(size_t begin, size_t end, F &&f)
+{
+  if (begin >= end)
+    return;
+
+  struct State
+  {
+    std::atomic<size_t> next;
+    size_t end;
+    std::mutex mutex;
+    std::condition_variable done;
+    int running{0};
+    bool closed{false};
+  };
+
+  auto state = std::make_shared<State>();
+  state->next = begin;
+  state->end = end;
+
+  auto *func = &f;
+  auto run = [state, func]() {
+    for (size_t i = state->next++; i < state->end; i = state->next++)
+      (*func)(i);
+  };
+
+  // helpers that only get scheduled after the loop is over must not touch f
+  const size_t numHelpers = std::min(size(), end - begin - 1);
+  for (size_t h = 0; h < numHelpers; h++) {
+    push([state, run]() {
+      {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->closed)
+          return;
+        state->running++;
+      }
+      run();
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (--state->running == 0)
+        state->done.notify_all();
+    });
+  }
+
+  run();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->closed = true;
+  state->done.wait(lock, [&]() { return state->running == 0; });
+}
+
+} // namespace my_viewer
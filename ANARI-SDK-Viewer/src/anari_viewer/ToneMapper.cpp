@@ -0,0 +1,224 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#include "ToneMapper.h"
+#include "HDRImage.h"
+#include "ThreadPool.h"
+// std
+#include <cmath>
+#include <cstdio>
+
+#include "common.h"
+
+namespace my_viewer {
+
+// a single triangle covering the viewport, no vertex buffers needed
+static const char *VERTEX_SHADER = R"(
+#version 130
+out vec2 uv;
+
+void main()
+{
+    uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+static const char *FRAGMENT_SHADER = R"(
+#version 130
+in vec2 uv;
+
+uniform sampler2D hdrImage;
+uniform float exposure;
+uniform int toneMapOperator;
+
+// fit of the ACES filmic curve by K. Narkowicz
+vec3 aces(vec3 x)
+{
+    return (x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14);
+}
+
+void main()
+{
+    vec4 hdr = texture(hdrImage, uv);
+    vec3 color = hdr.rgb * exposure;
+    if (toneMapOperator == 1)
+        color = color / (1.0 + color);
+    else if (toneMapOperator == 2)
+        color = aces(color);
+    color = clamp(color, 0.0, 1.0);
+
+    vec3 srgb = 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055;
+    color = mix(color * 12.92, srgb, step(0.0031308, color));
+    gl_FragColor = vec4(color, hdr.a);
+}
+)";
+
+static GLuint compileShader(GLenum type, const char *source)
+{
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, nullptr);
+  glCompileShader(shader);
+
+  GLint compiled = GL_FALSE;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+  if (compiled != GL_TRUE) {
+    char log[512];
+    glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+    printf("tone mapping shader failed to compile: %s\n", log);
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+ToneMapper::ToneMapper()
+{
+  // glad leaves the entry points null on contexts without them
+  if (glCreateShader == nullptr || glGenFramebuffers == nullptr)
+    return;
+
+  GLuint vertexShader = compileShader(GL_VERTEX_SHADER, VERTEX_SHADER);
+  GLuint pixelShader = compileShader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER);
+  if (vertexShader != 0 && pixelShader != 0) {
+    m_program = glCreateProgram();
+    glAttachShader(m_program, vertexShader);
+    glAttachShader(m_program, pixelShader);
+    glLinkProgram(m_program);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(m_program, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE) {
+      glDeleteProgram(m_program);
+      m_program = 0;
+    }
+  }
+  glDeleteShader(vertexShader);
+  glDeleteShader(pixelShader);
+
+  if (m_program == 0)
+    return;
+
+  m_exposureLocation = glGetUniformLocation(m_program, "exposure");
+  m_operatorLocation = glGetUniformLocation(m_program, "toneMapOperator");
+  glUseProgram(m_program);
+  glUniform1i(glGetUniformLocation(m_program, "hdrImage"), 0);
+  glUseProgram(0);
+
+  glGenFramebuffers(1, &m_framebuffer);
+
+  glGenTextures(1, &m_hdrTexture);
+  glBindTexture(GL_TEXTURE_2D, m_hdrTexture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+ToneMapper::~ToneMapper()
+{
+  if (m_program == 0)
+    return;
+
+  glDeleteTextures(1, &m_hdrTexture);
+  glDeleteFramebuffers(1, &m_framebuffer);
+  glDeleteProgram(m_program);
+}
+
+bool ToneMapper::valid() const
+{
+  return m_program != 0;
+}
+
+void ToneMapper::upload(int imageWidth,
+    int imageHeight,
+    int rowBegin,
+    int width,
+    int height,
+    const float *rgba)
+{
+  TRACE_SCOPE("ToneMapper::upload");
+
+  glBindTexture(GL_TEXTURE_2D, m_hdrTexture);
+
+  if (imageWidth != m_width || imageHeight != m_height) {
+    glTexImage2D(GL_TEXTURE_2D,
+        0,
+        GL_RGBA16F,
+        imageWidth,
+        imageHeight,
+        0,
+        GL_RGBA,
+        GL_HALF_FLOAT,
+        0);
+    m_width = imageWidth;
+    m_height = imageHeight;
+    m_hasImage = false;
+  }
+
+  if (width > m_width || rowBegin + height > m_height)
+    return;
+
+  // half the bytes of float texels through the driver, converted in parallel
+  const size_t rowSize = size_t(width) * 4;
+  m_halfTexels.resize(rowSize * height);
+  ThreadPool::global().parallelFor(0, height, [&](size_t y) {
+    importers::HDRImage::floatToHalf(
+        rgba + y * rowSize, m_halfTexels.data() + y * rowSize, rowSize);
+  });
+
+  glTexSubImage2D(GL_TEXTURE_2D,
+      0,
+      0,
+      rowBegin,
+      width,
+      height,
+      GL_RGBA,
+      GL_HALF_FLOAT,
+      m_halfTexels.data());
+  m_hasImage = true;
+}
+
+bool ToneMapper::hasImage() const
+{
+  return m_hasImage;
+}
+
+void ToneMapper::apply(GLuint target)
+{
+  TRACE_SCOPE("ToneMapper::apply");
+
+  if (!valid() || !m_hasImage)
+    return;
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  const GLboolean blend = glIsEnabled(GL_BLEND);
+  const GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+  const GLboolean depth = glIsEnabled(GL_DEPTH_TEST);
+  glDisable(GL_BLEND);
+  glDisable(GL_SCISSOR_TEST);
+  glDisable(GL_DEPTH_TEST);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+  glFramebufferTexture2D(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+  glViewport(0, 0, m_width, m_height);
+
+  glUseProgram(m_program);
+  glUniform1f(m_exposureLocation, std::exp2(exposure));
+  glUniform1i(m_operatorLocation, int(op));
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, m_hdrTexture);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glUseProgram(0);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  if (blend)
+    glEnable(GL_BLEND);
+  if (scissor)
+    glEnable(GL_SCISSOR_TEST);
+  if (depth)
+    glEnable(GL_DEPTH_TEST);
+}
+
+} // namespace my_viewer
@@ -0,0 +1,67 @@
+// Copyright 2024 Ishansh Lal
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// glad
+#include "glad/glad.h"
+// std
+#include <cstdint>
+#include <vector>
+
+namespace my_viewer {
+
+// Keeps float frames as half float texels on the GPU and tone maps them into
+// an 8 bit texture with a fragment shader. Needs GL 3.0 for framebuffer
+// objects and GLSL 1.30, valid() is false when the context lacks either.
+class ToneMapper
+{
+ public:
+  enum Operator
+  {
+    CLAMP,
+    REINHARD,
+    ACES
+  };
+
+  ToneMapper();
+  ~ToneMapper();
+
+  ToneMapper(const ToneMapper &) = delete;
+  ToneMapper &operator=(const ToneMapper &) = delete;
+
+  bool valid() const;
+
+  // rows [rowBegin, rowBegin + height) of the HDR image from RGBA float
+  // texels, converted to half before the upload. The image is resized to
+  // imageWidth x imageHeight first if needed.
+  void upload(int imageWidth,
+      int imageHeight,
+      int rowBegin,
+      int width,
+      int height,
+      const float *rgba);
+
+  // an HDR image was uploaded since the last resize
+  bool hasImage() const;
+
+  // writes the tone mapped, sRGB encoded image into target, an RGBA8 texture
+  // of the same size
+  void apply(GLuint target);
+
+  float exposure{0.f}; // in stops
+  Operator op{ACES};
+
+ private:
+  GLuint m_program{0};
+  GLuint m_framebuffer{0};
+  GLuint m_hdrTexture{0};
+  GLint m_exposureLocation{-1};
+  GLint m_operatorLocation{-1};
+  int m_width{0};
+  int m_height{0};
+  bool m_hasImage{false};
+  std::vector<uint16_t> m_halfTexels;
+};
+
+} // namespace my_viewer
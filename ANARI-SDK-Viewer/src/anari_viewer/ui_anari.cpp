@@ -5,7 +5,12 @@
 // anari_viewer
 #include "nfd.h"
 // std
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <limits>
+#include <map>
+#include <mutex>
 
 namespace my_viewer::ui {
 
@@ -115,6 +120,270 @@ ParameterList parseParameters(
   return retval;
 }
 
+void setParameter(anari::Device d, anari::Object o, const Parameter &p)
+{
+  if (p.value.type() == ANARI_STRING)
+    anari::setParameter(d, o, p.name.c_str(), p.value.getString());
+  else
+    anari::setParameter(d, o, p.name.c_str(), p.value.type(), p.value.data());
+}
+
+// Parameter cache /////////////////////////////////////////////////////////////
+
+static constexpr char PARAMETER_CACHE_MAGIC[4] = {'A', 'P', 'C', '1'};
+
+static std::mutex g_parameterCacheMutex;
+static std::map<std::string, ParameterList> g_parameterCache;
+
+static std::string deviceKey(anari::Device d)
+{
+  const char *name = nullptr;
+  int32_t version = 0;
+  anariGetProperty(
+      d, d, "version.name", ANARI_STRING, &name, sizeof(name), ANARI_WAIT);
+  anariGetProperty(
+      d, d, "version", ANARI_INT32, &version, sizeof(version), ANARI_WAIT);
+  return std::string(name ? name : "unknown") + "@" + std::to_string(version);
+}
+
+const ParameterList &cachedParameters(
+    anari::Device d, ANARIDataType objectType, const char *subtype)
+{
+  const std::string key = deviceKey(d) + "/"
+      + std::to_string(int(objectType)) + "/" + subtype;
+
+  std::lock_guard<std::mutex> lock(g_parameterCacheMutex);
+  auto found = g_parameterCache.find(key);
+  if (found == g_parameterCache.end()) {
+    found = g_parameterCache
+                .emplace(key, parseParameters(d, objectType, subtype))
+                .first;
+  }
+  return found->second;
+}
+
+static void writeString(FILE *file, const std::string &s)
+{
+  const uint32_t size = uint32_t(s.size());
+  fwrite(&size, sizeof(size), 1, file);
+  fwrite(s.data(), 1, size, file);
+}
+
+static bool readString(FILE *file, std::string &s)
+{
+  uint32_t size = 0;
+  if (fread(&size, sizeof(size), 1, file) != 1)
+    return false;
+  s.resize(size);
+  return fread(s.data(), 1, size, file) == size;
+}
+
+// objects are stored as null handles, like parseParameters() creates them
+static void writeValue(FILE *file, const Any &value)
+{
+  const ANARIDataType type = value.type();
+  const uint8_t valid = value.valid();
+  fwrite(&type, sizeof(type), 1, file);
+  fwrite(&valid, sizeof(valid), 1, file);
+  if (!valid || anari::isObject(type))
+    return;
+  if (type == ANARI_STRING)
+    writeString(file, value.getString());
+  else
+    fwrite(value.data(), anari::sizeOf(type), 1, file);
+}
+
+static bool readValue(FILE *file, Any &value)
+{
+  ANARIDataType type = ANARI_UNKNOWN;
+  uint8_t valid = 0;
+  if (fread(&type, sizeof(type), 1, file) != 1
+      || fread(&valid, sizeof(valid), 1, file) != 1)
+    return false;
+
+  if (!valid)
+    value = Any();
+  else if (type == ANARI_STRING) {
+    std::string s;
+    if (!readString(file, s))
+      return false;
+    value = Any(ANARI_STRING, s.c_str());
+  } else if (anari::isObject(type)) {
+    value = parseValue(type, nullptr);
+  } else {
+    const size_t size = anari::sizeOf(type);
+    if (size == 0 || size > 256)
+      return false;
+    uint8_t bytes[256];
+    if (fread(bytes, size, 1, file) != 1)
+      return false;
+    value = Any(type, bytes);
+  }
+  return true;
+}
+
+bool loadParameterCache(const char *fileName)
+{
+  FILE *file = fopen(fileName, "rb");
+  if (file == nullptr)
+    return false;
+
+  std::map<std::string, ParameterList> entries;
+  char magic[4] = {};
+  uint32_t numEntries = 0;
+  bool ok = fread(magic, sizeof(magic), 1, file) == 1
+      && memcmp(magic, PARAMETER_CACHE_MAGIC, sizeof(magic)) == 0
+      && fread(&numEntries, sizeof(numEntries), 1, file) == 1;
+
+  for (uint32_t e = 0; ok && e < numEntries; e++) {
+    std::string key;
+    uint32_t numParameters = 0;
+    ok = readString(file, key)
+        && fread(&numParameters, sizeof(numParameters), 1, file) == 1;
+
+    ParameterList &parameters = entries[key];
+    for (uint32_t i = 0; ok && i < numParameters; i++) {
+      Parameter p;
+      uint32_t numStrings = 0;
+      ok = readString(file, p.name) && readString(file, p.description)
+          && readValue(file, p.value) && readValue(file, p.min)
+          && readValue(file, p.max)
+          && fread(&numStrings, sizeof(numStrings), 1, file) == 1;
+      p.stringValues.resize(ok ? numStrings : 0);
+      for (auto &s : p.stringValues)
+        ok = ok && readString(file, s);
+      parameters.push_back(p);
+    }
+  }
+
+  fclose(file);
+
+  if (!ok) {
+    printf("Ignoring invalid parameter cache: %s\n", fileName);
+    return false;
+  }
+
+  // entries already parsed in this run are kept
+  std::lock_guard<std::mutex> lock(g_parameterCacheMutex);
+  g_parameterCache.merge(entries);
+  return true;
+}
+
+bool saveParameterCache(const char *fileName)
+{
+  FILE *file = fopen(fileName, "wb");
+  if (file == nullptr)
+    return false;
+
+  std::lock_guard<std::mutex> lock(g_parameterCacheMutex);
+
+  const uint32_t numEntries = uint32_t(g_parameterCache.size());
+  fwrite(PARAMETER_CACHE_MAGIC, sizeof(PARAMETER_CACHE_MAGIC), 1, file);
+  fwrite(&numEntries, sizeof(numEntries), 1, file);
+
+  for (auto &[key, parameters] : g_parameterCache) {
+    const uint32_t numParameters = uint32_t(parameters.size());
+    writeString(file, key);
+    fwrite(&numParameters, sizeof(numParameters), 1, file);
+    for (auto &p : parameters) {
+      const uint32_t numStrings = uint32_t(p.stringValues.size());
+      writeString(file, p.name);
+      writeString(file, p.description);
+      writeValue(file, p.value);
+      writeValue(file, p.min);
+      writeValue(file, p.max);
+      fwrite(&numStrings, sizeof(numStrings), 1, file);
+      for (auto &s : p.stringValues)
+        writeString(file, s);
+    }
+  }
+
+  const bool ok = ferror(file) == 0;
+  fclose(file);
+  return ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+size_t hashParameters(const ParameterList &parameters)
+{
+  // FNV-1a
+  size_t hash = 14695981039346656037ull;
+  auto combine = [&](const void *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+      hash ^= ((const uint8_t *)data)[i];
+      hash *= 1099511628211ull;
+    }
+  };
+
+  for (auto &p : parameters) {
+    const ANARIDataType type = p.value.type();
+    combine(p.name.data(), p.name.size());
+    combine(&type, sizeof(type));
+    if (type == ANARI_STRING) {
+      const std::string value = p.value.getString();
+      combine(value.data(), value.size());
+    } else if (p.value.valid() && !anari::isObject(type))
+      combine(p.value.data(), anari::sizeOf(type));
+  }
+
+  return hash;
+}
+
+// ParameterBatch definitions ////////////////////////////////////////////////
+
+ParameterBatch::~ParameterBatch()
+{
+  clear();
+}
+
+void ParameterBatch::set(anari::Device d, anari::Object o, const Parameter &p)
+{
+  auto pending = std::find_if(m_pending.begin(),
+      m_pending.end(),
+      [&](const Pending &pb) { return pb.device == d && pb.object == o; });
+
+  if (pending == m_pending.end()) {
+    // held until flushed, the owner may release it in the meantime
+    anari::retain(d, o);
+    m_pending.push_back({d, o, {}});
+    pending = m_pending.end() - 1;
+  }
+
+  auto &parameters = pending->parameters;
+  auto same = std::find_if(parameters.begin(),
+      parameters.end(),
+      [&](const Parameter &q) { return q.name == p.name; });
+  if (same != parameters.end())
+    *same = p;
+  else
+    parameters.push_back(p);
+}
+
+bool ParameterBatch::empty() const
+{
+  return m_pending.empty();
+}
+
+void ParameterBatch::flush()
+{
+  for (auto &pending : m_pending) {
+    for (auto &p : pending.parameters)
+      setParameter(pending.device, pending.object, p);
+    anari::commitParameters(pending.device, pending.object);
+  }
+  clear();
+}
+
+void ParameterBatch::clear()
+{
+  for (auto &pending : m_pending)
+    anari::release(pending.device, pending.object);
+  m_pending.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 bool buildUI(Parameter &p)
 {
   bool update = false;
@@ -232,19 +501,4 @@ void buildUI(anari::scenes::SceneHandle s, Parameter &p)
     anari::scenes::setParameter(s, p.name, p.value);
 }
 
-void buildUI(anari::Device d, anari::Object o, Parameter &p)
-{
-  ANARIDataType type = p.value.type();
-  const char *name = p.name.c_str();
-  void *value = p.value.data();
-
-  if (buildUI(p)) {
-    if (p.value.type() == ANARI_STRING)
-      anari::setParameter(d, o, name, p.value.getString());
-    else
-      anari::setParameter(d, o, name, type, value);
-    anari::commitParameters(d, o);
-  }
-}
-
 } // namespace anari_viewer::ui
@@ -26,8 +26,49 @@ using ParameterList = std::vector<Parameter>;
 ParameterList parseParameters(
     anari::Device d, ANARIDataType objectType, const char *subtype);
 
+// Process wide cache of parseParameters(), keyed by the device implementation,
+// object type and subtype. Each entry is parsed the first time it is asked
+// for; the whole cache can be kept on disk between runs.
+const ParameterList &cachedParameters(
+    anari::Device d, ANARIDataType objectType, const char *subtype);
+bool loadParameterCache(const char *fileName);
+bool saveParameterCache(const char *fileName);
+
+void setParameter(anari::Device d, anari::Object o, const Parameter &p);
+
+// hash of the parameter names and current values
+size_t hashParameters(const ParameterList &parameters);
+
+// Parameter edits held back until flush(), which sets the latest value of
+// each parameter and commits every touched object once. Lets a dragged
+// slider cost one commit per rendered frame instead of one per UI event.
+class ParameterBatch
+{
+ public:
+  ParameterBatch() = default;
+  ~ParameterBatch();
+
+  ParameterBatch(const ParameterBatch &) = delete;
+  ParameterBatch &operator=(const ParameterBatch &) = delete;
+
+  void set(anari::Device d, anari::Object o, const Parameter &p);
+  bool empty() const;
+  void flush();
+  // drops the pending edits
+  void clear();
+
+ private:
+  struct Pending
+  {
+    anari::Device device{nullptr};
+    anari::Object object{nullptr};
+    ParameterList parameters;
+  };
+
+  std::vector<Pending> m_pending;
+};
+
 bool buildUI(Parameter &p);
 void buildUI(anari::scenes::SceneHandle s, Parameter &p);
-void buildUI(anari::Device d, anari::Object o, Parameter &p);
 
 } // namespace anari_viewer::ui
@@ -3,9 +3,11 @@
 
 #include "LightsEditor.h"
 #include "../HDRImage.h"
+#include "../ThreadPool.h"
 // anari_viewer
 #include "nfd.h"
 // std
+#include <algorithm>
 #include <cmath>
 
 namespace my_viewer::windows {
@@ -26,11 +28,39 @@ static const char *lightToType(Light::LightType type)
   }
 }
 
+static bool acceptsRadiance(anari::Device d, ANARIDataType elementType)
+{
+  const auto *types = (const ANARIDataType *)anariGetParameterInfo(d,
+      ANARI_LIGHT,
+      "hdri",
+      "radiance",
+      ANARI_ARRAY2D,
+      "elementType",
+      ANARI_DATA_TYPE_LIST);
+
+  for (; types && *types != ANARI_UNKNOWN; types++) {
+    if (*types == elementType)
+      return true;
+  }
+  return false;
+}
+
+// the array keeps its own reference to the texels, which may be shared
+static void releaseTexels(const void *userData, const void *)
+{
+  delete (const std::shared_ptr<void> *)userData;
+}
+
 LightsEditor::LightsEditor(std::vector<anari::Device> devices, const char *name)
     : Window(name, true), m_devices(devices)
 {
-  for (auto d : m_devices)
+  m_radianceVec4 = true;
+  m_radianceHalf = true;
+  for (auto d : m_devices) {
     anari::retain(d, d);
+    m_radianceVec4 &= acceptsRadiance(d, ANARI_FLOAT32_VEC4);
+    m_radianceHalf &= acceptsRadiance(d, ANARI_FLOAT16_VEC3);
+  }
   addNewLight(Light::DIRECTIONAL);
   m_worlds.resize(m_devices.size(), nullptr);
 }
@@ -42,7 +72,12 @@ LightsEditor::LightsEditor(anari::Device device, const char *name)
 LightsEditor::~LightsEditor()
 {
   releaseWorlds();
+  releaseLightsArrays();
   for (auto &l : m_lights) {
+    if (l.hdriLoad)
+      l.hdriLoad->cancel();
+    if (l.hdriPrepare)
+      l.hdriPrepare->cancel();
     for (int i = 0; i < int(m_devices.size()); i++)
       anari::release(m_devices[i], l.handles[i]);
   }
@@ -76,13 +111,12 @@ void LightsEditor::buildUI()
 
     ImGui::Text("type: %s", lightToType(l.type));
 
-    bool update = false;
-
     if (l.type != Light::HDRI) {
-      update |=
-          ImGui::DragFloat("intensity", &l.intensity, 0.001f, 0.f, 1000.f);
+      if (ImGui::DragFloat("intensity", &l.intensity, 0.001f, 0.f, 1000.f))
+        l.dirty |= Light::INTENSITY;
 
-      update |= ImGui::ColorEdit3("color", &l.color.x);
+      if (ImGui::ColorEdit3("color", &l.color.x))
+        l.dirty |= Light::COLOR;
     }
 
     if (l.type == Light::DIRECTIONAL || l.type == Light::SPOT) {
@@ -95,24 +129,24 @@ void LightsEditor::buildUI()
       };
 
       if (ImGui::DragFloat("azimuth", &l.directionalAZEL.x, 0.1f)) {
-        update = true;
+        l.dirty |= Light::DIRECTION;
         l.directionalAZEL.x = maintainUnitCircle(l.directionalAZEL.x);
       }
 
       if (ImGui::DragFloat("elevation", &l.directionalAZEL.y, 0.1f)) {
-        update = true;
+        l.dirty |= Light::DIRECTION;
         l.directionalAZEL.y = maintainUnitCircle(l.directionalAZEL.y);
       }
     }
     if (l.type == Light::POINT || l.type == Light::SPOT) {
       if (ImGui::DragFloat3("position", &l.pointPosition.x, 0.1f))
-        update = true;
+        l.dirty |= Light::POSITION;
     }
 
     if (l.type == Light::SPOT) {
       if (ImGui::DragFloat(
               "openingAngle", &l.openingAngle, 0.01f, 0.0f, 6.2832f))
-        update = true;
+        l.dirty |= Light::OPENING_ANGLE;
     }
 
     if (l.type == Light::HDRI) {
@@ -148,15 +182,49 @@ void LightsEditor::buildUI()
           text_cb,
           &l);
 
-      ImGui::DragFloat("scale", &l.scale, 0.01f, 10.f);
+      if (ImGui::DragFloat("scale", &l.scale, 0.01f, 10.f))
+        l.dirty |= Light::SCALE;
+
+      bool reupload = false;
+      if (l.hdriImage) {
+        // the hdri light takes a single radiance array, lower resolutions
+        // only trade detail for memory
+        const int halvings = int(l.hdriImage->halvings());
+        reupload |= ImGui::SliderInt("radiance resolution",
+            &l.hdriHalvings,
+            0,
+            halvings,
+            l.hdriHalvings == 0 ? "full" : "halved %d times");
+        ImGui::SameLine();
+        ImGui::Text("%ux%u",
+            std::max(1u, l.hdriImage->width >> l.hdriHalvings),
+            std::max(1u, l.hdriImage->height >> l.hdriHalvings));
+      }
+
+      ImGui::BeginDisabled(!m_radianceHalf);
+      reupload |= ImGui::Checkbox("half float texels", &l.hdriHalf);
+      ImGui::EndDisabled();
 
-      update = ImGui::Button("update");
+      if (reupload)
+        prepareRadiance(l);
+
+      if (ImGui::Button("update"))
+        loadRadiance(l);
+
+      if (l.hdriLoad) {
+        ImGui::ProgressBar(l.hdriLoad->progress(), ImVec2(250.f, 0.f));
+        ImGui::SameLine();
+        if (ImGui::Button("cancel")) {
+          l.hdriLoad->cancel();
+          l.hdriLoad.reset();
+        }
+      }
     }
 
     if (ImGui::Button("remove"))
       lightToRemove = &l;
 
-    if (update)
+    if (l.dirty)
       updateLight(l);
 
     ImGui::PopID();
@@ -168,6 +236,13 @@ void LightsEditor::buildUI()
   ImGui::PopItemWidth();
 }
 
+template <typename F>
+void LightsEditor::forEachDevice(F &&f)
+{
+  // devices are independent, their set/commit sequences run side by side
+  ThreadPool::global().parallelFor(0, m_devices.size(), f);
+}
+
 void LightsEditor::setWorld(anari::World world)
 {
   assert(m_devices.size() == 1);
@@ -183,6 +258,30 @@ void LightsEditor::setWorlds(std::vector<anari::World> worlds)
   updateLightsArray();
 }
 
+void LightsEditor::setUpdateCallback(LightsUpdateCallback cb)
+{
+  m_updateCallback = cb;
+}
+
+void LightsEditor::update()
+{
+  for (auto &l : m_lights)
+    pollRadiance(l);
+}
+
+bool LightsEditor::loading() const
+{
+  return std::any_of(m_lights.begin(), m_lights.end(), [](const Light &l) {
+    return l.hdriLoad != nullptr || l.hdriPrepare != nullptr;
+  });
+}
+
+void LightsEditor::notifyUpdate()
+{
+  if (m_updateCallback)
+    m_updateCallback();
+}
+
 void LightsEditor::releaseWorlds()
 {
   for (int i = 0; i < int(m_devices.size()); i++)
@@ -198,12 +297,20 @@ void LightsEditor::addNewLight(Light::LightType type)
         anari::newObject<anari::Light>(m_devices[i], lightToType(type)));
   }
   updateLight(l);
+  if (type == Light::HDRI)
+    updateRadiance(l, nullptr);
   m_lights.push_back(l);
+  m_lightsChanged = true;
   updateLightsArray();
 }
 
 void LightsEditor::removeLight(Light *toRemove)
 {
+  if (toRemove->hdriLoad)
+    toRemove->hdriLoad->cancel();
+  if (toRemove->hdriPrepare)
+    toRemove->hdriPrepare->cancel();
+
   for (int i = 0; i < int(m_devices.size()); i++)
     anari::release(m_devices[i], toRemove->handles[i]);
 
@@ -212,23 +319,29 @@ void LightsEditor::removeLight(Light *toRemove)
                      [&](const auto &l) -> bool { return &l == toRemove; }),
       m_lights.end());
 
+  m_lightsChanged = true;
   updateLightsArray();
 }
 
-void LightsEditor::updateLight(const Light &l)
+void LightsEditor::updateLight(Light &l)
 {
-  for (int i = 0; i < int(m_devices.size()); i++) {
+  auto radians = [](float degrees) -> float {
+    return degrees * M_PI / 180.f;
+  };
+
+  forEachDevice([&](size_t i) {
     auto device = m_devices[i];
     auto light = l.handles[i];
-    anari::setParameter(device, light, "intensity", l.intensity);
-    anari::setParameter(device, light, "irradiance", l.intensity);
-    anari::setParameter(device, light, "color", l.color);
 
-    auto radians = [](float degrees) -> float {
-      return degrees * M_PI / 180.f;
-    };
+    if (l.dirty & Light::INTENSITY) {
+      anari::setParameter(device, light, "intensity", l.intensity);
+      anari::setParameter(device, light, "irradiance", l.intensity);
+    }
+    if (l.dirty & Light::COLOR)
+      anari::setParameter(device, light, "color", l.color);
 
-    if (l.type == Light::DIRECTIONAL || l.type == Light::SPOT) {
+    if ((l.dirty & Light::DIRECTION)
+        && (l.type == Light::DIRECTIONAL || l.type == Light::SPOT)) {
       const float az = radians(l.directionalAZEL.x);
       const float el = radians(l.directionalAZEL.y);
       anari::math::float3 dir(std::sin(az) * std::cos(el),
@@ -236,77 +349,169 @@ void LightsEditor::updateLight(const Light &l)
           std::cos(az) * std::cos(el));
       anari::setParameter(device, light, "direction", dir);
     }
-    if (l.type == Light::POINT || l.type == Light::SPOT) {
+    if ((l.dirty & Light::POSITION)
+        && (l.type == Light::POINT || l.type == Light::SPOT)) {
       anari::setParameter(device, light, "position", l.pointPosition);
     }
-    if (l.type == Light::SPOT) {
+    if ((l.dirty & Light::OPENING_ANGLE) && l.type == Light::SPOT) {
       anari::setParameter(device, light, "openingAngle", l.openingAngle);
     }
-    if (l.type == Light::HDRI) {
-      std::vector<float> pixel;
-      unsigned width = 0, height = 0;
-      importers::HDRImage hdrImg;
-      if (hdrImg.load(l.hdriRadiance)) {
-        pixel.resize(hdrImg.width * hdrImg.height * 3);
-        width = hdrImg.width;
-        height = hdrImg.height;
-        if (hdrImg.numComponents == 3) {
-          std::copy(hdrImg.pixel.begin(), hdrImg.pixel.end(), pixel.begin());
-        } else if (hdrImg.numComponents == 4) {
-          for (size_t i = 0; i < hdrImg.pixel.size(); i += 4) {
-            size_t i3 = i / 4 * 3;
-            pixel[i3] = hdrImg.pixel[i];
-            pixel[i3 + 1] = hdrImg.pixel[i + 1];
-            pixel[i3 + 2] = hdrImg.pixel[i + 2];
-          }
-        } else {
-          printf("Error loading HDR image, unsupported num. components: %u\n",
-              hdrImg.numComponents);
-          pixel.clear();
-          width = height = 0;
-        }
-      }
+    if ((l.dirty & Light::SCALE) && l.type == Light::HDRI) {
+      anari::setParameter(device, light, "scale", l.scale);
+    }
 
-      if (pixel.empty()) {
-        // Fill with dummy data:
-        pixel.resize(6, 1.f);
-        width = 2;
-        height = 1;
-      }
+    anari::commitParameters(device, light);
+  });
 
-      ANARIArray2D radiance = anariNewArray2D(
-          device, pixel.data(), 0, 0, ANARI_FLOAT32_VEC3, width, height);
+  l.dirty = 0;
+  notifyUpdate();
+}
 
-      anari::setParameter(device, light, "radiance", radiance);
-      anari::setParameter(device, light, "scale", l.scale);
+void LightsEditor::loadRadiance(Light &l)
+{
+  if (l.hdriRadiance.empty())
+    return;
+
+  // the same unchanged file is already uploaded
+  if (l.hdriLoad == nullptr && l.hdriImage && l.hdriImageFile == l.hdriRadiance
+      && l.hdriImageKey == importers::HDRImage::fileKey(l.hdriRadiance))
+    return;
+
+  // a newer file supersedes whatever is still decoding for this light
+  if (l.hdriLoad) {
+    if (l.hdriLoad->fileName() == l.hdriRadiance)
+      return;
+    l.hdriLoad->cancel();
+  }
+
+  l.hdriLoad = m_hdrLoader.load(l.hdriRadiance, m_radianceVec4);
+}
 
-      anariRelease(device, radiance);
+void LightsEditor::pollRadiance(Light &l)
+{
+  if (l.hdriLoad && l.hdriLoad->ready()) {
+    auto image = l.hdriLoad->take();
+    const std::string fileName = l.hdriLoad->fileName();
+    l.hdriLoad.reset();
+    if (image) {
+      l.hdriImage = std::move(image);
+      l.hdriImageFile = fileName;
+      l.hdriImageKey = importers::HDRImage::fileKey(fileName);
+      l.hdriHalvings = std::min(l.hdriHalvings, int(l.hdriImage->halvings()));
+      prepareRadiance(l);
     }
+  }
 
-    anari::commitParameters(device, light);
+  if (l.hdriPrepare && l.hdriPrepare->ready()) {
+    auto texels = l.hdriPrepare->take();
+    l.hdriPrepare.reset();
+    if (texels)
+      updateRadiance(l, &*texels);
   }
 }
 
-void LightsEditor::updateLightsArray()
+void LightsEditor::prepareRadiance(Light &l)
 {
-  if (m_worlds.empty() || !m_worlds[0])
+  if (!l.hdriImage)
     return;
 
-  for (int i = 0; i < int(m_devices.size()); i++) {
+  // a newer resolution or format supersedes the one still being built
+  if (l.hdriPrepare)
+    l.hdriPrepare->cancel();
+
+  // only the full image stays on the light, a lower resolution is built for
+  // the upload and lives on in the devices' arrays
+  l.hdriPrepare = m_hdrLoader.prepare(
+      *l.hdriImage, l.hdriHalvings, l.hdriHalf && m_radianceHalf);
+}
+
+void LightsEditor::updateRadiance(
+    const Light &l, const importers::HDRTexels *texels)
+{
+  // Fill with dummy data until an image is loaded:
+  static const float dummy[6] = {1.f, 1.f, 1.f, 1.f, 1.f, 1.f};
+  std::shared_ptr<void> data = texels ? texels->data : nullptr;
+  const void *pixel = data ? data.get() : dummy;
+  ANARIDataType elementType = ANARI_FLOAT32_VEC3;
+  if (texels && texels->half)
+    elementType = ANARI_FLOAT16_VEC3;
+  else if (texels && texels->numComponents == 4)
+    elementType = ANARI_FLOAT32_VEC4;
+  const unsigned width = texels ? texels->width : 2;
+  const unsigned height = texels ? texels->height : 1;
+
+  forEachDevice([&](size_t i) {
+    auto device = m_devices[i];
+    auto light = l.handles[i];
+
+    // the devices read the texels in place, no copy is made here
+    auto *reference = data ? new std::shared_ptr<void>(data) : nullptr;
+    ANARIArray2D radiance = anariNewArray2D(device,
+        pixel,
+        reference ? releaseTexels : nullptr,
+        reference,
+        elementType,
+        width,
+        height);
+
+    // a failed array never calls the deleter
+    if (!radiance) {
+      delete reference;
+      return;
+    }
+
+    anari::setParameter(device, light, "radiance", radiance);
+    anari::commitParameters(device, light);
+
+    anariRelease(device, radiance);
+  });
+
+  notifyUpdate();
+}
+
+void LightsEditor::updateLightsArray()
+{
+  // arrays have a fixed size, new ones are only needed when the count changes
+  const bool newArrays = m_lightsChanged && !m_lights.empty();
+  if (m_lightsChanged)
+    releaseLightsArrays();
+  m_lightsChanged = false;
+
+  const bool hasWorlds = !m_worlds.empty() && m_worlds[0];
+
+  forEachDevice([&](size_t i) {
     auto device = m_devices[i];
+
+    if (newArrays) {
+      auto array = anari::newArray1D(device, ANARI_LIGHT, m_lights.size());
+      auto *handles = anari::map<anari::Light>(device, array);
+      for (size_t j = 0; j < m_lights.size(); j++)
+        handles[j] = m_lights[j].handles[i];
+      anari::unmap(device, array);
+      m_lightsArrays[i] = array;
+    }
+
+    if (!hasWorlds)
+      return;
+
     auto world = m_worlds[i];
     if (m_lights.empty())
       anari::unsetParameter(device, world, "light");
-    else {
-      std::vector<anari::Light> tmp;
-      for (auto &l : m_lights)
-        tmp.push_back(l.handles[i]);
-      anari::setAndReleaseParameter(device,
-          world,
-          "light",
-          anari::newArray1D(device, tmp.data(), tmp.size()));
-    }
+    else
+      anari::setParameter(device, world, "light", m_lightsArrays[i]);
     anari::commitParameters(device, world);
+  });
+
+  notifyUpdate();
+}
+
+void LightsEditor::releaseLightsArrays()
+{
+  m_lightsArrays.resize(m_devices.size(), nullptr);
+  for (int i = 0; i < int(m_devices.size()); i++) {
+    if (m_lightsArrays[i])
+      anari::release(m_devices[i], m_lightsArrays[i]);
+    m_lightsArrays[i] = nullptr;
   }
 }
 
@@ -7,13 +7,19 @@
 #include <anari/anari_cpp/ext/linalg.h>
 #include <anari/anari_cpp.hpp>
 // std
+#include <functional>
+#include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
+#include "../HDRLoader.h"
 #include "Window.h"
 
 namespace my_viewer::windows {
 
+using LightsUpdateCallback = std::function<void()>;
+
 struct Light
 {
   enum LightType
@@ -23,7 +29,19 @@ struct Light
     SPOT,
     HDRI
   };
+  // parameters that changed since they were last set on the devices
+  enum DirtyFlags : unsigned
+  {
+    INTENSITY = 1 << 0,
+    COLOR = 1 << 1,
+    DIRECTION = 1 << 2,
+    POSITION = 1 << 3,
+    OPENING_ANGLE = 1 << 4,
+    SCALE = 1 << 5,
+    ALL = ~0u
+  };
   LightType type{DIRECTIONAL};
+  unsigned dirty{ALL};
   float intensity{1.f};
   float openingAngle{3.14159f};
   anari::math::float3 color{1.f};
@@ -31,6 +49,18 @@ struct Light
   anari::math::float3 pointPosition{0.f};
   std::string hdriRadiance;
   float scale{1.f};
+  // radiance decoding in the background, applied once it completes
+  std::shared_ptr<importers::HDRLoad> hdriLoad;
+  // full resolution, kept to upload other resolutions or formats without
+  // reloading
+  std::optional<importers::HDRImage> hdriImage;
+  std::string hdriImageFile;
+  uint64_t hdriImageKey{0};
+  int hdriHalvings{0}; // the radiance is uploaded at 1/2^n resolution
+  bool hdriHalf{false};
+  // the radiance at the selected resolution and format, built in the
+  // background and uploaded once it completes
+  std::shared_ptr<importers::HDRPrepare> hdriPrepare;
   std::vector<anari::Light> handles;
 };
 
@@ -46,18 +76,49 @@ struct LightsEditor : public Window
   void setWorld(anari::World world);
   void setWorlds(std::vector<anari::World> worlds);
 
+  // called after light changes were committed to the devices
+  void setUpdateCallback(LightsUpdateCallback cb);
+
+  // applies HDRIs that finished decoding or preparing, called every frame
+  // whether or not the window is drawn
+  void update();
+  // an HDRI is still decoding or preparing in the background
+  bool loading() const;
+
  private:
+  void notifyUpdate();
   void releaseWorlds();
   void addNewLight(Light::LightType type);
   void removeLight(Light *toRemove);
-  void updateLight(const Light &l);
+  void updateLight(Light &l);
+  void loadRadiance(Light &l);
+  void prepareRadiance(Light &l);
+  // nullptr uploads placeholder radiance
+  void updateRadiance(const Light &l, const importers::HDRTexels *texels);
+  void pollRadiance(Light &l);
   void updateLightsArray();
+  void releaseLightsArrays();
+  // f(deviceIndex) for every device, on the global thread pool
+  template <typename F>
+  void forEachDevice(F &&f);
 
   // ANARI //
 
   std::vector<anari::Device> m_devices;
   std::vector<anari::World> m_worlds;
   std::vector<Light> m_lights;
+  // one array of light handles per device, recreated only when lights are
+  // added or removed and attached again to every new world
+  std::vector<anari::Array1D> m_lightsArrays;
+  bool m_lightsChanged{true};
+
+  LightsUpdateCallback m_updateCallback;
+
+  importers::HDRLoader m_hdrLoader;
+  // every device takes 4 component radiance, no RGBA to RGB packing needed
+  bool m_radianceVec4{false};
+  // every device takes half float radiance
+  bool m_radianceHalf{false};
 };
 
 } // namespace anari_viewer::windows
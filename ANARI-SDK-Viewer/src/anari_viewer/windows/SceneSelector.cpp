@@ -26,10 +26,7 @@ SceneSelector::SceneSelector(const char *name) : Window(name, true)
   }
 }
 
-SceneSelector::~SceneSelector()
-{
-  anari::scenes::release(m_scene);
-}
+SceneSelector::~SceneSelector() = default;
 
 void SceneSelector::buildUI()
 {
@@ -53,19 +50,32 @@ void SceneSelector::buildUI()
   if (newCategory || newScene)
     notify();
 
+  if (m_buildProgress >= 0.f) {
+    std::string overlay = "building " + m_buildSceneName + "...";
+    ImGui::ProgressBar(m_buildProgress, ImVec2(-1.f, 0.f), overlay.c_str());
+  }
+
   ImGui::Separator();
 
   if (m_parameters.empty())
     return;
 
-  for (auto &p : m_parameters)
-    ui::buildUI(m_scene, p);
+  for (auto &p : m_parameters) {
+    if (ui::buildUI(p)) {
+      for (auto s : m_activeScenes)
+        anari::scenes::setParameter(s, p.name, p.value);
+    }
+  }
 
   ImGui::NewLine();
 
   if (ImGui::Button("update")) {
     try {
-      anari::scenes::commit(m_scene);
+      for (auto s : m_activeScenes)
+        anari::scenes::commit(s);
+      m_committedHash = ui::hashParameters(m_parameters);
+      if (m_updateCallback)
+        m_updateCallback();
     } catch (const std::runtime_error &e) {
       printf("%s\n", e.what());
     }
@@ -78,11 +88,34 @@ void SceneSelector::setCallback(SceneSelectionCallback cb)
   notify();
 }
 
+void SceneSelector::setUpdateCallback(SceneUpdateCallback cb)
+{
+  m_updateCallback = cb;
+}
+
 void SceneSelector::setScene(anari::scenes::SceneHandle scene)
 {
-  anari::scenes::release(m_scene);
-  m_scene = scene;
-  m_parameters = getParameters(scene);
+  setScenes({scene});
+}
+
+void SceneSelector::setScenes(std::vector<anari::scenes::SceneHandle> scenes)
+{
+  m_activeScenes = scenes;
+  m_parameters.clear();
+  if (!m_activeScenes.empty())
+    m_parameters = getParameters(m_activeScenes[0]);
+  m_committedHash = ui::hashParameters(m_parameters);
+}
+
+size_t SceneSelector::committedParametersHash() const
+{
+  return m_committedHash;
+}
+
+void SceneSelector::setBuildProgress(float progress, const char *sceneName)
+{
+  m_buildProgress = progress;
+  m_buildSceneName = sceneName;
 }
 
 void SceneSelector::notify()
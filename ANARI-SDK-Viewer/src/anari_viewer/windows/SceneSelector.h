@@ -14,6 +14,7 @@
 namespace my_viewer::windows {
 
 using SceneSelectionCallback = std::function<void(const char *, const char *)>;
+using SceneUpdateCallback = std::function<void()>;
 
 struct SceneSelector : public Window
 {
@@ -23,8 +24,19 @@ struct SceneSelector : public Window
   void buildUI() override;
 
   void setCallback(SceneSelectionCallback cb);
+  // called after parameter edits were committed to the active scenes
+  void setUpdateCallback(SceneUpdateCallback cb);
 
+  // scenes stay owned by the caller
   void setScene(anari::scenes::SceneHandle scene);
+  // one instance of the same scene per device, parameters apply to all
+  void setScenes(std::vector<anari::scenes::SceneHandle> scenes);
+
+  // hash of the parameter values the active scenes were last committed with
+  size_t committedParametersHash() const;
+
+  // progress of a background scene build, < 0 when nothing is building
+  void setBuildProgress(float progress, const char *sceneName = "");
 
  private:
   void notify();
@@ -33,12 +45,17 @@ struct SceneSelector : public Window
   std::vector<std::vector<std::string>> m_scenes;
 
   SceneSelectionCallback m_callback;
+  SceneUpdateCallback m_updateCallback;
 
-  anari::scenes::SceneHandle m_scene{nullptr};
+  std::vector<anari::scenes::SceneHandle> m_activeScenes;
   ui::ParameterList m_parameters;
+  size_t m_committedHash{0};
 
   int m_currentCategory{0};
   int m_currentScene{0};
+
+  float m_buildProgress{-1.f};
+  std::string m_buildSceneName;
 };
 
 } // namespace anari_viewer::windows
@@ -2,19 +2,65 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "Viewport.h"
+// anari_viewer
+#include "nfd.h"
 // std
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <cstring>
-// stb_image
-#include "stb_image_write.h"
+
+#include "common.h"
 
 namespace my_viewer::windows {
 
+using Clock = std::chrono::steady_clock;
+
+static float millisecondsSince(Clock::time_point start)
+{
+  return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+}
+
+// Copies the rows of a float channel of a strip into the gathered frame.
+// Rows the device did not provide are zeroed, which the post-processing
+// stages treat as no information: without depth no history is reused.
+static void gatherChannel(anari::Device device,
+    anari::Frame frame,
+    const char *channel,
+    int components,
+    std::vector<float> &dst,
+    size_t rowBegin,
+    uint32_t width,
+    uint32_t height)
+{
+  const size_t count = size_t(width) * height * components;
+  float *rows = dst.data() + rowBegin * width * components;
+  auto mapped = anari::map<float>(device, frame, channel);
+  if (mapped.data && mapped.width == width && mapped.height == height)
+    std::copy(mapped.data, mapped.data + count, rows);
+  else
+    std::fill(rows, rows + count, 0.f);
+  anari::unmap(device, frame, channel);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Viewport definitions ///////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
+int Viewport::Strip::rows() const
+{
+  return rowEnd - rowBegin;
+}
+
 Viewport::Viewport(anari::Device device, const char *name)
-    : Window(name, true), m_device(device)
+    : Viewport(std::vector<anari::Device>{device}, name)
+{}
+
+Viewport::Viewport(std::vector<anari::Device> devices, const char *name)
+    : Window(name, true), m_device(devices.front())
 {
   setManipulator(nullptr);
 
@@ -42,30 +88,36 @@ Viewport::Viewport(anari::Device device, const char *name)
 
   // ANARI //
 
-  anari::retain(m_device, m_device);
-
+  // all devices are expected to come from the same library, the primary
+  // device is the one queried for renderer subtypes and their parameters
   const char **r_subtypes = anariGetObjectSubtypes(m_device, ANARI_RENDERER);
 
   if (r_subtypes != nullptr) {
-    for (int i = 0; r_subtypes[i] != nullptr; i++) {
-      std::string subtype = r_subtypes[i];
-      auto parameters =
-          ui::parseParameters(m_device, ANARI_RENDERER, subtype.c_str());
-      m_rendererNames.push_back(subtype);
-      m_rendererParameters.push_back(parameters);
-    }
+    for (int i = 0; r_subtypes[i] != nullptr; i++)
+      m_rendererNames.push_back(r_subtypes[i]);
+    m_rendererParameters.resize(m_rendererNames.size());
   } else
     m_rendererNames.emplace_back("default");
 
-  anari::commitParameters(m_device, m_device);
-
-  m_frame = anari::newObject<anari::Frame>(m_device);
-  m_perspCamera = anari::newObject<anari::Camera>(m_device, "perspective");
-  m_orthoCamera = anari::newObject<anari::Camera>(m_device, "orthographic");
+  for (auto d : devices) {
+    anari::retain(d, d);
+    anari::commitParameters(d, d);
+
+    Strip s;
+    s.device = d;
+    s.share = 1.f / devices.size();
+    s.slots.resize(m_numFrames + 1);
+    for (auto &slot : s.slots)
+      slot.frame = anari::newObject<anari::Frame>(d);
+    s.perspCamera = anari::newObject<anari::Camera>(d, "perspective");
+    s.orthoCamera = anari::newObject<anari::Camera>(d, "orthographic");
+
+    for (auto &name : m_rendererNames) {
+      s.renderers.push_back(
+          anari::newObject<anari::Renderer>(d, name.c_str()));
+    }
 
-  for (auto &name : m_rendererNames) {
-    m_renderers.push_back(
-        anari::newObject<anari::Renderer>(m_device, name.c_str()));
+    m_strips.push_back(s);
   }
 
   reshape(m_viewportSize);
@@ -78,15 +130,21 @@ Viewport::Viewport(anari::Device device, const char *name)
 Viewport::~Viewport()
 {
   cancelFrame();
-  anari::wait(m_device, m_frame);
+  m_pendingParameters.clear();
+
+  for (auto &s : m_strips) {
+    for (auto &slot : s.slots) {
+      anari::wait(s.device, slot.frame);
+      anari::release(s.device, slot.frame);
+    }
 
-  anari::release(m_device, m_perspCamera);
-  anari::release(m_device, m_orthoCamera);
-  anari::release(m_device, m_world);
-  for (auto &r : m_renderers)
-    anari::release(m_device, r);
-  anari::release(m_device, m_frame);
-  anari::release(m_device, m_device);
+    anari::release(s.device, s.perspCamera);
+    anari::release(s.device, s.orthoCamera);
+    anari::release(s.device, s.world);
+    for (auto &r : s.renderers)
+      anari::release(s.device, r);
+    anari::release(s.device, s.device);
+  }
 }
 
 void Viewport::buildUI()
@@ -110,8 +168,10 @@ void Viewport::buildUI()
 
   ui_contextMenu();
 
-  if (!m_contextMenuVisible)
+  if (!m_contextMenuVisible && !m_pathPlaying)
     ui_handleInput();
+
+  updateInteraction();
 }
 
 void Viewport::setManipulator(manipulators::Orbit *m)
@@ -121,17 +181,28 @@ void Viewport::setManipulator(manipulators::Orbit *m)
 
 void Viewport::setWorld(anari::World world, bool resetCameraView)
 {
-  if (m_world)
-    anari::release(m_device, m_world);
+  assert(m_strips.size() == 1 || !world);
+  setWorlds(std::vector<anari::World>(m_strips.size(), world), resetCameraView);
+}
 
-  if (!world) {
-    world = anari::newObject<anari::World>(m_device);
-    resetCameraView = false;
-  } else
-    anari::retain(m_device, world);
+void Viewport::setWorlds(std::vector<anari::World> worlds, bool resetCameraView)
+{
+  for (size_t i = 0; i < m_strips.size(); i++) {
+    auto &s = m_strips[i];
+    auto world = i < worlds.size() ? worlds[i] : nullptr;
 
-  anari::commitParameters(m_device, world);
-  m_world = world;
+    if (s.world)
+      anari::release(s.device, s.world);
+
+    if (!world) {
+      world = anari::newObject<anari::World>(s.device);
+      resetCameraView = false;
+    } else
+      anari::retain(s.device, world);
+
+    anari::commitParameters(s.device, world);
+    s.world = world;
+  }
 
   if (resetCameraView)
     resetView();
@@ -144,7 +215,7 @@ void Viewport::resetView(bool resetAzEl)
   anari::math::float3 bounds[2] = {{0.f, 0.f, 0.f}, {1.f, 1.f, 1.f}};
 
   if (!anariGetProperty(m_device,
-          m_world,
+          m_strips[0].world,
           "bounds",
           ANARI_FLOAT32_BOX3,
           &bounds[0],
@@ -166,12 +237,153 @@ anari::Device Viewport::device() const
   return m_device;
 }
 
+void Viewport::setHostTimings(float uiMS, float presentMS)
+{
+  m_pendingSample.ui = uiMS;
+  m_pendingSample.present = presentMS;
+}
+
+void Viewport::useCompletionCallbacks(bool enable)
+{
+  if (enable == m_completionCallbacks)
+    return;
+
+  // frames already in flight were started without the callback
+  cancelFrame();
+  waitForFrames();
+  m_completionCallbacks = enable;
+  updateFrame();
+}
+
+bool Viewport::usesCompletionCallbacks() const
+{
+  return m_completionCallbacks;
+}
+
+void Viewport::setMaxSamples(int maxSamples)
+{
+  m_maxSamples = std::max(0, maxSamples);
+  // the sample count starts over against the new limit
+  restartAccumulation();
+}
+
+bool Viewport::converged() const
+{
+  return m_converged;
+}
+
+void Viewport::restartAccumulation()
+{
+  m_converged = false;
+  m_generation++;
+  m_presentedFrames = 0;
+}
+
+void Viewport::setGuideChannels(bool albedo, bool normal)
+{
+  m_albedoChannel = albedo;
+  m_normalChannel = normal;
+  if (m_denoise)
+    updateFrame();
+}
+
+void Viewport::startPathRecording()
+{
+  if (m_pathPlaying)
+    return;
+
+  m_cameraPath.clear();
+  m_pathRecording = true;
+  m_pathRecordStart = Clock::now();
+  m_cameraPath.record(*m_arcball, 0.f);
+}
+
+void Viewport::stopPathRecording()
+{
+  m_pathRecording = false;
+}
+
+bool Viewport::loadCameraPath(const char *fileName)
+{
+  if (m_pathRecording || m_pathPlaying)
+    return false;
+
+  if (!m_cameraPath.load(fileName)) {
+    printf("failed to load camera path '%s'\n", fileName);
+    return false;
+  }
+
+  printf("loaded camera path '%s' (%zu keys)\n",
+      fileName,
+      m_cameraPath.size());
+  return true;
+}
+
+void Viewport::playCameraPath(int samplesPerKey, std::string reportFile)
+{
+  if (m_pathRecording || m_pathPlaying || m_cameraPath.empty())
+    return;
+
+  m_pathPlaying = true;
+  m_pathKey = 0;
+  m_pathReport = std::move(reportFile);
+  m_pathTimings.clear();
+
+  // keys are done once they hold their samples, mouse input stays off
+  m_pathSavedMaxSamples = m_maxSamples;
+  setMaxSamples(std::max(1, samplesPerKey));
+  m_manipulating = false;
+
+  applyPathKey();
+}
+
+void Viewport::stopPathPlayback()
+{
+  if (!m_pathPlaying)
+    return;
+
+  const int samplesPerKey = m_maxSamples;
+  m_pathPlaying = false;
+  setMaxSamples(m_pathSavedMaxSamples);
+
+  // a key interrupted by stopping early has no meaningful timing
+  if (!m_pathTimings.empty() && m_pathTimings.back().total == 0.f)
+    m_pathTimings.pop_back();
+
+  const char *report = m_pathReport.c_str();
+  if (CameraPath::writeReport(report, m_pathTimings, samplesPerKey))
+    printf("camera path report saved to '%s'\n", report);
+  else
+    printf("failed to write camera path report '%s'\n", report);
+
+  if (m_pathFinishedCallback)
+    m_pathFinishedCallback();
+}
+
+bool Viewport::playingCameraPath() const
+{
+  return m_pathPlaying;
+}
+
+void Viewport::setPathFinishedCallback(CameraPathCallback cb)
+{
+  m_pathFinishedCallback = cb;
+}
+
+void Viewport::applyPathKey()
+{
+  CameraPath::apply(m_cameraPath[m_pathKey], *m_arcball);
+  m_pathTimings.emplace_back();
+  m_pathKeyStart = Clock::now();
+}
+
 void Viewport::reshape(anari::math::int2 newSize)
 {
   if (newSize.x <= 0 || newSize.y <= 0)
     return;
 
   m_viewportSize = newSize;
+  m_textureSize = newSize;
 
   glViewport(0, 0, newSize.x, newSize.y);
 
@@ -192,29 +404,151 @@ void Viewport::reshape(anari::math::int2 newSize)
 
 void Viewport::startNewFrame()
 {
-  anari::getProperty(
-      m_device, m_frame, "numSamples", m_frameSamples, ANARI_NO_WAIT);
-  anari::render(m_device, m_frame);
-  m_renderSize = m_viewportSize;
-  m_currentlyRendering = true;
+  // every edit since the last frame lands in a single commit per renderer
+  m_pendingParameters.flush();
+  commitCamera();
+
+  // the device accumulates into the frame object, so accumulating frames all
+  // render into slot 0, one at a time
+  int slot = 0;
+  if (m_interactiveFrame) {
+    slot = m_nextSlot;
+    m_nextSlot = (m_nextSlot + 1) % int(m_strips[0].slots.size());
+  }
+
+  for (auto &s : m_strips) {
+    auto &fs = s.slots[slot];
+    fs.rendering = s.rows() > 0;
+    fs.completed = false;
+    if (!fs.rendering)
+      continue;
+    fs.renderRowBegin = s.rowBegin;
+    anari::render(s.device, fs.frame);
+  }
+
+  InFlight frame;
+  frame.slot = slot;
+  frame.size = m_frameSize;
+  frame.generation = m_generation;
+  frame.view.eye = m_arcball->eye();
+  frame.view.dir = m_arcball->dir();
+  frame.view.up = m_arcball->up();
+  frame.view.fovy = m_fov * float(M_PI) / 180.f;
+  frame.view.aspect = m_viewportSize.x / float(m_viewportSize.y);
+  m_inFlight.push_back(frame);
+
   m_frameCancelled = false;
 }
 
 void Viewport::updateFrame()
 {
-  anari::setParameter(
-      m_device, m_frame, "size", anari::math::uint2(m_viewportSize));
-  anari::setParameter(m_device, m_frame, "channel.color", m_format);
-  anari::setParameter(m_device, m_frame, "accumulation", true);
-  anari::setParameter(m_device, m_frame, "world", m_world);
-  if (m_useOrthoCamera)
-    anari::setParameter(m_device, m_frame, "camera", m_orthoCamera);
-  else
-    anari::setParameter(m_device, m_frame, "camera", m_perspCamera);
-  anari::setParameter(
-      m_device, m_frame, "renderer", m_renderers[m_currentRenderer]);
+  m_frameSize = m_viewportSize;
+  if (m_interactiveFrame) {
+    m_frameSize = linalg::max(
+        m_viewportSize / m_interactiveDownscale, anari::math::int2(1));
+  }
+
+  // split the frame rows by share, the last strip takes the remainder
+  int row = 0;
+  for (size_t i = 0; i < m_strips.size(); i++) {
+    auto &s = m_strips[i];
+    int rowEnd = m_frameSize.y;
+    if (i + 1 < m_strips.size()) {
+      rowEnd = row + std::max(1, int(std::lround(s.share * m_frameSize.y)));
+      rowEnd = std::min(rowEnd, m_frameSize.y);
+    }
+    s.rowBegin = row;
+    s.rowEnd = rowEnd;
+    row = rowEnd;
+  }
+
+  for (auto &s : m_strips) {
+    if (s.rows() <= 0)
+      continue;
+
+    for (auto &slot : s.slots) {
+      auto frame = slot.frame;
+      anari::setParameter(s.device,
+          frame,
+          "size",
+          anari::math::uint2(m_frameSize.x, s.rows()));
+      anari::setParameter(s.device, frame, "channel.color", m_format);
+      anari::setParameter(
+          s.device, frame, "accumulation", !m_interactiveFrame);
+      if (m_reproject || m_denoise)
+        anari::setParameter(s.device, frame, "channel.depth", ANARI_FLOAT32);
+      else
+        anari::unsetParameter(s.device, frame, "channel.depth");
+      if (m_denoise && m_albedoChannel) {
+        anari::setParameter(
+            s.device, frame, "channel.albedo", ANARI_FLOAT32_VEC3);
+      } else {
+        anari::unsetParameter(s.device, frame, "channel.albedo");
+      }
+      if (m_denoise && m_normalChannel) {
+        anari::setParameter(
+            s.device, frame, "channel.normal", ANARI_FLOAT32_VEC3);
+      } else {
+        anari::unsetParameter(s.device, frame, "channel.normal");
+      }
+      anari::setParameter(s.device, frame, "world", s.world);
+      if (m_useOrthoCamera)
+        anari::setParameter(s.device, frame, "camera", s.orthoCamera);
+      else
+        anari::setParameter(s.device, frame, "camera", s.perspCamera);
+      anari::setParameter(
+          s.device, frame, "renderer", s.renderers[m_currentRenderer]);
+
+      if (m_completionCallbacks) {
+        ANARIFrameCompletionCallback callback = &Viewport::frameCompleted;
+        const void *userData = this;
+        anari::setParameter(s.device,
+            frame,
+            "frameCompletionCallback",
+            ANARI_FRAME_COMPLETION_CALLBACK,
+            &callback);
+        anari::setParameter(s.device,
+            frame,
+            "frameCompletionCallbackUserData",
+            ANARI_VOID_POINTER,
+            &userData);
+      } else {
+        anari::unsetParameter(s.device, frame, "frameCompletionCallback");
+        anari::unsetParameter(
+            s.device, frame, "frameCompletionCallbackUserData");
+      }
+
+      anari::commitParameters(s.device, frame);
+    }
+  }
 
-  anari::commitParameters(m_device, m_frame);
+  // the image regions moved
+  m_perspCameraStale = true;
+  m_orthoCameraStale = true;
+
+  restartAccumulation();
+}
+
+void Viewport::updateInteraction()
+{
+  // rows only move when the camera comes to rest, accumulation starts over
+  // then anyway; on every camera change a single noisy duration would
+  // recommit every frame
+  const bool released = m_wasManipulating && !m_manipulating;
+  m_wasManipulating = m_manipulating;
+  const bool rebalanced = released && rebalanceStrips();
+
+  const bool interactive = m_progressiveRefinement && m_manipulating;
+  if (interactive == m_interactiveFrame && !rebalanced)
+    return;
+
+  m_interactiveFrame = interactive;
+
+  // a full resolution frame still in flight is stale by the time it lands
+  if (interactive && !m_inFlight.empty())
+    cancelFrame();
+
+  updateFrame();
 }
 
 void Viewport::updateCamera(bool force)
@@ -222,100 +556,504 @@ void Viewport::updateCamera(bool force)
   if (!force && !m_arcball->hasChanged(m_cameraToken))
     return;
 
-  anari::setParameter(m_device, m_perspCamera, "position", m_arcball->eye());
-  anari::setParameter(m_device, m_perspCamera, "direction", m_arcball->dir());
-  anari::setParameter(m_device, m_perspCamera, "up", m_arcball->up());
-
-  anari::setParameter(
-      m_device, m_orthoCamera, "position", m_arcball->eye_FixedDistance());
-  anari::setParameter(m_device, m_orthoCamera, "direction", m_arcball->dir());
-  anari::setParameter(m_device, m_orthoCamera, "up", m_arcball->up());
-  anari::setParameter(
-      m_device, m_orthoCamera, "height", m_arcball->distance() * 0.75f);
-
-  anari::setParameter(m_device,
-      m_perspCamera,
-      "aspect",
-      m_viewportSize.x / float(m_viewportSize.y));
-  anari::setParameter(m_device,
-      m_orthoCamera,
-      "aspect",
-      m_viewportSize.x / float(m_viewportSize.y));
+  if (m_pathRecording) {
+    const float time =
+        std::chrono::duration<float>(Clock::now() - m_pathRecordStart).count();
+    m_cameraPath.record(*m_arcball, time);
+  }
+
+  // only the bound camera is committed, once, when the next frame starts; the
+  // other one catches up when it gets bound
+  m_perspCameraStale = true;
+  m_orthoCameraStale = true;
+
+  restartAccumulation();
+}
+
+void Viewport::commitCamera()
+{
+  bool &stale = m_useOrthoCamera ? m_orthoCameraStale : m_perspCameraStale;
+  if (!stale)
+    return;
+  stale = false;
 
   auto radians = [](float degrees) -> float { return degrees * M_PI / 180.f; };
-  anari::setParameter(m_device, m_perspCamera, "fovy", radians(m_fov));
 
-  anari::commitParameters(m_device, m_perspCamera);
-  anari::commitParameters(m_device, m_orthoCamera);
+  const float aspect = m_viewportSize.x / float(m_viewportSize.y);
+
+  for (auto &s : m_strips) {
+    if (s.rows() <= 0)
+      continue;
+
+    auto camera = m_useOrthoCamera ? s.orthoCamera : s.perspCamera;
+
+    if (m_useOrthoCamera) {
+      anari::setParameter(
+          s.device, camera, "position", m_arcball->eye_FixedDistance());
+      anari::setParameter(
+          s.device, camera, "height", m_arcball->distance() * 0.75f);
+    } else {
+      anari::setParameter(s.device, camera, "position", m_arcball->eye());
+      anari::setParameter(s.device, camera, "fovy", radians(m_fov));
+    }
+    anari::setParameter(s.device, camera, "direction", m_arcball->dir());
+    anari::setParameter(s.device, camera, "up", m_arcball->up());
+    anari::setParameter(s.device, camera, "aspect", aspect);
+
+    // every device sees the full image plane and renders its own region
+    const float region[4] = {0.f,
+        s.rowBegin / float(m_frameSize.y),
+        1.f,
+        s.rowEnd / float(m_frameSize.y)};
+    anari::setParameter(
+        s.device, camera, "imageRegion", ANARI_FLOAT32_BOX2, region);
+
+    anari::commitParameters(s.device, camera);
+  }
 }
 
 void Viewport::updateImage()
 {
-  if (m_frameCancelled)
-    anari::wait(m_device, m_frame);
-  else if (m_saveNextFrame
-      || (m_currentlyRendering && anari::isReady(m_device, m_frame))) {
-    m_currentlyRendering = false;
-
-    float duration = 0.f;
-    anari::getProperty(m_device, m_frame, "duration", duration);
-
-    m_latestFL = duration * 1000;
-    m_minFL = std::min(m_minFL, m_latestFL);
-    m_maxFL = std::max(m_maxFL, m_latestFL);
-
-    auto fb = anari::map<uint32_t>(m_device, m_frame, "channel.color");
-
-    if (fb.data) {
-      const bool isByteChannles = fb.pixelType == ANARI_UFIXED8_RGBA_SRGB
-          || fb.pixelType == ANARI_UFIXED8_VEC4;
-      if (isByteChannles) {
-        glBindTexture(GL_TEXTURE_2D, m_framebufferTexture);
-        glTexSubImage2D(GL_TEXTURE_2D,
-            0,
-            0,
-            0,
-            fb.width,
-            fb.height,
-            GL_RGBA,
-            GL_UNSIGNED_BYTE,
-            fb.data);
-      } else {
-        glBindTexture(GL_TEXTURE_2D, m_framebufferTexture);
-        glTexSubImage2D(GL_TEXTURE_2D,
-            0,
-            0,
-            0,
+  TRACE_SCOPE("Viewport::updateImage");
+
+  // renderer edits are flushed by startNewFrame(), which a converged viewport
+  // no longer calls
+  if (!m_pendingParameters.empty())
+    restartAccumulation();
+
+  if (m_frameCancelled) {
+    waitForFrames();
+  } else if (!m_inFlight.empty()) {
+    const InFlight oldest = m_inFlight.front();
+
+    anari::Frame completed = nullptr;
+    while (m_completedFrames.pop(completed)) {
+      for (auto &s : m_strips) {
+        for (auto &slot : s.slots) {
+          if (slot.frame == completed)
+            slot.completed = true;
+        }
+      }
+    }
+
+    // a screenshot waits for the frame instead of polling it
+    bool ready = true;
+    for (auto &s : m_strips) {
+      auto &slot = s.slots[oldest.slot];
+      if (!slot.rendering || m_saveNextFrame)
+        continue;
+      if (m_completionCallbacks ? !slot.completed
+                                : !anari::isReady(s.device, slot.frame))
+        ready = false;
+    }
+
+    if (ready) {
+      m_inFlight.pop_front();
+      // the devices get the next interactive frame before this one is copied
+      // out, the next accumulating frame renders into the same slot
+      if (m_interactiveFrame)
+        fillPipeline();
+      presentFrame(oldest);
+    }
+  }
+
+  if (m_toneMapStale) {
+    m_toneMapper.apply(m_framebufferTexture);
+    m_toneMapStale = false;
+  }
+
+  // nothing renders anymore, the texture already holds the final image
+  if (m_saveNextFrame && m_inFlight.empty()) {
+    saveScreenshot();
+    m_saveNextFrame = false;
+  }
+
+  fillPipeline();
+}
+
+void Viewport::fillPipeline()
+{
+  // accumulating frames build on each other, only interactive ones overlap
+  const int numFrames = m_interactiveFrame ? m_numFrames : 1;
+  while (!m_converged && int(m_inFlight.size()) < numFrames)
+    startNewFrame();
+}
+
+void Viewport::presentFrame(const InFlight &frame)
+{
+  const int slot = frame.slot;
+  m_renderSize = frame.size;
+
+  const bool reportsSamples = anari::getProperty(m_device,
+      m_strips[0].slots[slot].frame,
+      "numSamples",
+      m_frameSamples,
+      ANARI_NO_WAIT);
+
+  const bool wasConverged = m_converged;
+  const bool accumulating =
+      frame.generation == m_generation && !m_interactiveFrame;
+  if (accumulating)
+    m_presentedFrames++;
+  const int samples = reportsSamples ? m_frameSamples : m_presentedFrames;
+  if (accumulating)
+    m_converged = m_maxSamples > 0 && samples >= m_maxSamples;
+
+  m_recordFrame = m_recording && m_converged && !wasConverged;
+  m_captureFrame = m_saveNextFrame || m_recordFrame;
+
+  // accumulation on the device beats reprojection once the camera rests
+  m_reprojectFrame = m_reproject && m_manipulating && !m_useOrthoCamera;
+  if (!m_reprojectFrame)
+    m_reprojector.reset();
+  // past a few samples the denoiser blurs more detail than noise
+  m_denoiseFrame = m_denoise && m_format == ANARI_FLOAT32_VEC4
+      && (m_interactiveFrame || samples < m_denoiseSamples);
+
+  float duration = 0.f;
+  for (auto &s : m_strips) {
+    auto &fs = s.slots[slot];
+    if (!fs.rendering)
+      continue;
+    uploadStrip(s, fs);
+    duration = std::max(duration, s.duration);
+  }
+
+  if (m_reprojectFrame || m_denoiseFrame)
+    postProcessFrame(frame.view);
+
+  m_latestFL = duration * 1000;
+  m_minFL = std::min(m_minFL, m_latestFL);
+  m_maxFL = std::max(m_maxFL, m_latestFL);
+
+  m_pendingSample.device = m_latestFL;
+  m_stats.push(m_pendingSample);
+  m_pendingSample.map = 0.f;
+  m_pendingSample.upload = 0.f;
+
+  writeCapture();
+
+  // frames started before the key was applied belong to an older generation
+  if (m_pathPlaying && accumulating) {
+    auto &timing = m_pathTimings.back();
+    if (timing.frames++ == 0)
+      timing.firstFrame = millisecondsSince(m_pathKeyStart);
+    timing.device += m_latestFL;
+
+    if (m_converged) {
+      timing.total = millisecondsSince(m_pathKeyStart);
+      // the camera change restarts accumulation in updateCamera()
+      if (++m_pathKey < m_cameraPath.size())
+        applyPathKey();
+      else
+        stopPathPlayback();
+    }
+  }
+}
+
+void Viewport::uploadStrip(Strip &s, Strip::Slot &slot)
+{
+  slot.rendering = false;
+
+  anari::getProperty(s.device, slot.frame, "duration", s.duration);
+
+  auto mapStart = Clock::now();
+  auto fb = anari::map<uint32_t>(s.device, slot.frame, "channel.color");
+  m_pendingSample.map += millisecondsSince(mapStart);
+
+  auto uploadStart = Clock::now();
+
+  if (fb.data) {
+    glBindTexture(GL_TEXTURE_2D, m_framebufferTexture);
+
+    // interactive frames are smaller than the viewport, the texture follows
+    // the frame and ImGui::Image() stretches it over the whole viewport
+    if (m_textureSize != m_renderSize) {
+      glTexImage2D(GL_TEXTURE_2D,
+          0,
+          GL_RGBA8,
+          m_renderSize.x,
+          m_renderSize.y,
+          0,
+          GL_RGBA,
+          GL_UNSIGNED_BYTE,
+          0);
+      m_textureSize = m_renderSize;
+    }
+
+    const bool isByteChannles = fb.pixelType == ANARI_UFIXED8_RGBA_SRGB
+        || fb.pixelType == ANARI_UFIXED8_VEC4;
+    const bool fits = int(fb.width) <= m_textureSize.x
+        && slot.renderRowBegin + int(fb.height) <= m_textureSize.y;
+
+    // a plain copy while the strip is mapped, encoding happens off thread
+    if (m_captureFrame && !m_capture) {
+      m_capture = m_frameWriter.acquire(
+          m_renderSize.x, m_renderSize.y, !isByteChannles);
+    }
+    if (m_capture && m_capture->isFloat == !isByteChannles
+        && int(fb.width) == m_capture->width
+        && slot.renderRowBegin + int(fb.height) <= m_capture->height) {
+      const size_t rowBytes = m_capture->rowBytes();
+      std::memcpy(m_capture->pixels.data() + slot.renderRowBegin * rowBytes,
+          fb.data,
+          rowBytes * fb.height);
+    }
+
+    if (m_reprojectFrame || m_denoiseFrame) {
+      auto &hf = m_hostFrame;
+      const size_t texelBytes = isByteChannles ? 4 : 4 * sizeof(float);
+      const size_t rowBytes = m_renderSize.x * texelBytes;
+      const size_t numPixels = size_t(m_renderSize.x) * m_renderSize.y;
+      const bool albedo = m_denoiseFrame && m_albedoChannel;
+      const bool normal = m_denoiseFrame && m_normalChannel;
+      hf.isFloat = !isByteChannles;
+      hf.color.resize(rowBytes * m_renderSize.y);
+      hf.depth.resize(numPixels);
+      hf.albedo.resize(albedo ? numPixels * 3 : 0);
+      hf.normal.resize(normal ? numPixels * 3 : 0);
+
+      if (fits && int(fb.width) == m_renderSize.x) {
+        const size_t row = slot.renderRowBegin;
+        std::memcpy(
+            hf.color.data() + row * rowBytes, fb.data, rowBytes * fb.height);
+        gatherChannel(s.device,
+            slot.frame,
+            "channel.depth",
+            1,
+            hf.depth,
+            row,
             fb.width,
-            fb.height,
-            GL_RGBA,
-            GL_FLOAT,
-            fb.data);
+            fb.height);
+        if (albedo) {
+          gatherChannel(s.device,
+              slot.frame,
+              "channel.albedo",
+              3,
+              hf.albedo,
+              row,
+              fb.width,
+              fb.height);
+        }
+        if (normal) {
+          gatherChannel(s.device,
+              slot.frame,
+              "channel.normal",
+              3,
+              hf.normal,
+              row,
+              fb.width,
+              fb.height);
+        }
       }
-    } else {
-      printf("mapped bad frame: %p | %i x %i\n", fb.data, fb.width, fb.height);
+    } else if (fits && !isByteChannles && m_toneMapper.valid()) {
+      m_toneMapper.upload(m_renderSize.x,
+          m_renderSize.y,
+          slot.renderRowBegin,
+          fb.width,
+          fb.height,
+          reinterpret_cast<const float *>(fb.data));
+      m_toneMapStale = true;
+    } else if (fits) {
+      glTexSubImage2D(GL_TEXTURE_2D,
+          0,
+          0,
+          slot.renderRowBegin,
+          fb.width,
+          fb.height,
+          GL_RGBA,
+          isByteChannles ? GL_UNSIGNED_BYTE : GL_FLOAT,
+          fb.data);
     }
+  } else {
+    printf("mapped bad frame: %p | %i x %i\n", fb.data, fb.width, fb.height);
+  }
+
+  m_pendingSample.upload += millisecondsSince(uploadStart);
+
+  anari::unmap(s.device, slot.frame, "channel.color");
+}
+
+void Viewport::postProcessFrame(const ReprojectionView &view)
+{
+  auto &hf = m_hostFrame;
+  const int width = m_renderSize.x;
+  const int height = m_renderSize.y;
+  if (hf.color.empty())
+    return;
+
+  auto uploadStart = Clock::now();
+
+  if (m_reprojectFrame) {
+    m_reprojector.apply(
+        view, width, height, hf.color.data(), hf.isFloat, hf.depth.data());
+  }
+
+  if (m_denoiseFrame && hf.isFloat) {
+    m_denoiser.apply(width,
+        height,
+        reinterpret_cast<float *>(hf.color.data()),
+        hf.albedo.empty() ? nullptr : hf.albedo.data(),
+        hf.normal.empty() ? nullptr : hf.normal.data(),
+        hf.depth.data());
+  }
+
+  if (hf.isFloat && m_toneMapper.valid()) {
+    m_toneMapper.upload(width,
+        height,
+        0,
+        width,
+        height,
+        reinterpret_cast<const float *>(hf.color.data()));
+    m_toneMapStale = true;
+  } else {
+    glBindTexture(GL_TEXTURE_2D, m_framebufferTexture);
+    glTexSubImage2D(GL_TEXTURE_2D,
+        0,
+        0,
+        0,
+        width,
+        height,
+        GL_RGBA,
+        hf.isFloat ? GL_FLOAT : GL_UNSIGNED_BYTE,
+        hf.color.data());
+  }
+
+  m_pendingSample.upload += millisecondsSince(uploadStart);
+}
+
+bool Viewport::rebalanceStrips()
+{
+  if (!m_loadBalance || m_strips.size() < 2)
+    return false;
+
+  // rows per second each device managed on its last frame
+  std::vector<float> throughput;
+  float total = 0.f;
+  for (auto &s : m_strips) {
+    if (s.duration <= 0.f || s.rows() <= 0)
+      return false;
+    throughput.push_back(s.share / s.duration);
+    total += throughput.back();
+  }
+
+  // move halfway towards the target to damp frame-to-frame noise
+  bool changed = false;
+  for (size_t i = 0; i < m_strips.size(); i++) {
+    auto &s = m_strips[i];
+    const float share = 0.5f * (s.share + throughput[i] / total);
+    changed |= std::abs(share - s.share) * m_frameSize.y >= 1.f;
+    s.share = share;
+  }
+
+  return changed;
+}
 
+void Viewport::saveScreenshot()
+{
+  // no frame is coming anymore, read the last one back from the texture
+  m_capture = m_frameWriter.acquire(m_textureSize.x, m_textureSize.y, false);
+  glBindTexture(GL_TEXTURE_2D, m_framebufferTexture);
+  glGetTexImage(
+      GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_capture->pixels.data());
+
+  m_captureFrame = true;
+  m_recordFrame = false;
+  writeCapture();
+}
+
+void Viewport::writeCapture()
+{
+  if (!m_captureFrame)
+    return;
+  m_captureFrame = false;
+
+  if (!m_capture)
+    return;
+
+  if (m_recordFrame) {
+    char baseName[32];
+    std::snprintf(baseName, sizeof(baseName), "frame%05d", m_recordIndex++);
     if (m_saveNextFrame) {
-      std::string filename =
-          "screenshot" + std::to_string(m_screenshotIndex++) + ".png";
-      stbi_write_png(
-          filename.c_str(), fb.width, fb.height, 4, fb.data, 4 * fb.width);
-      printf("frame saved to '%s'\n", filename.c_str());
-      m_saveNextFrame = false;
+      auto copy = m_frameWriter.acquire(
+          m_capture->width, m_capture->height, m_capture->isFloat);
+      copy.pixels = m_capture->pixels;
+      m_frameWriter.write(std::move(copy), baseName);
+    } else {
+      m_frameWriter.write(std::move(*m_capture), baseName);
     }
+  }
 
-    anari::unmap(m_device, m_frame, "channel.color");
+  if (m_saveNextFrame) {
+    m_frameWriter.write(std::move(*m_capture),
+        "screenshot" + std::to_string(m_screenshotIndex++));
+    m_saveNextFrame = false;
   }
 
-  if (!m_currentlyRendering || m_frameCancelled)
-    startNewFrame();
+  m_capture.reset();
 }
 
 void Viewport::cancelFrame()
 {
   m_frameCancelled = true;
-  anari::discard(m_device, m_frame);
+  for (auto &s : m_strips) {
+    for (auto &slot : s.slots) {
+      if (slot.rendering)
+        anari::discard(s.device, slot.frame);
+    }
+  }
+}
+
+void Viewport::setFramesInFlight(int numFrames)
+{
+  cancelFrame();
+  waitForFrames();
+
+  // one slot more than frames in flight, the presented frame is mapped while
+  // the next one renders
+  for (auto &s : m_strips) {
+    while (int(s.slots.size()) > numFrames + 1) {
+      anari::release(s.device, s.slots.back().frame);
+      s.slots.pop_back();
+    }
+    while (int(s.slots.size()) < numFrames + 1) {
+      Strip::Slot slot;
+      slot.frame = anari::newObject<anari::Frame>(s.device);
+      s.slots.push_back(slot);
+    }
+  }
+
+  m_numFrames = numFrames;
+  m_nextSlot = 0;
+
+  updateFrame();
+}
+
+void Viewport::waitForFrames()
+{
+  for (auto &s : m_strips) {
+    for (auto &slot : s.slots) {
+      anari::wait(s.device, slot.frame);
+      slot.rendering = false;
+      slot.completed = false;
+    }
+  }
+
+  // completions of the frames just waited on are stale now
+  anari::Frame completed = nullptr;
+  while (m_completedFrames.pop(completed))
+    ;
+
+  m_inFlight.clear();
+}
+
+void Viewport::frameCompleted(
+    const void *userData, ANARIDevice, ANARIFrame frame)
+{
+  auto *viewport = static_cast<Viewport *>(const_cast<void *>(userData));
+  // the queue holds 64 entries, far more than frames can be in flight
+  viewport->m_completedFrames.push(frame);
+  glfwPostEmptyEvent();
 }
 
 void Viewport::ui_handleInput()
@@ -392,7 +1130,7 @@ void Viewport::ui_contextMenu()
     ImGui::Text("Renderer:");
     ImGui::Indent(INDENT_AMOUNT);
 
-    if (m_renderers.size() > 1 && ImGui::BeginMenu("subtype")) {
+    if (m_rendererNames.size() > 1 && ImGui::BeginMenu("subtype")) {
       for (int i = 0; i < m_rendererNames.size(); i++) {
         if (ImGui::MenuItem(m_rendererNames[i].c_str())) {
           m_currentRenderer = i;
@@ -404,9 +1142,17 @@ void Viewport::ui_contextMenu()
 
     if (!m_rendererParameters.empty() && ImGui::BeginMenu("parameters")) {
       auto &parameters = m_rendererParameters[m_currentRenderer];
-      auto renderer = m_renderers[m_currentRenderer];
-      for (auto &p : parameters)
-        ui::buildUI(m_device, renderer, p);
+      if (!parameters) {
+        parameters = ui::cachedParameters(m_device,
+            ANARI_RENDERER,
+            m_rendererNames[m_currentRenderer].c_str());
+      }
+      for (auto &p : *parameters) {
+        if (!ui::buildUI(p))
+          continue;
+        for (auto &s : m_strips)
+          m_pendingParameters.set(s.device, s.renderers[m_currentRenderer], p);
+      }
       ImGui::EndMenu();
     }
 
@@ -454,18 +1200,137 @@ void Viewport::ui_contextMenu()
       if (format != m_format)
         updateFrame();
 
+      if (m_format == ANARI_FLOAT32_VEC4 && m_toneMapper.valid()) {
+        ImGui::Separator();
+
+        m_toneMapStale |= ImGui::SliderFloat(
+            "exposure", &m_toneMapper.exposure, -8.f, 8.f, "%.1f stops");
+
+        const char *operators[] = {"clamp", "Reinhard", "ACES"};
+        int op = m_toneMapper.op;
+        if (ImGui::Combo("tone mapping", &op, operators, 3)) {
+          m_toneMapper.op = ToneMapper::Operator(op);
+          m_toneMapStale = true;
+        }
+      }
+
       ImGui::EndMenu();
     }
 
+    ImGui::Checkbox("progressive refinement", &m_progressiveRefinement);
+
+    ImGui::BeginDisabled(!m_progressiveRefinement);
+    // only interactive frames are downscaled, an accumulated image is kept and
+    // the factor applies once the camera moves
+    if (ImGui::SliderInt("interactive downscale", &m_interactiveDownscale, 1, 8)
+        && m_interactiveFrame)
+      updateFrame();
+    ImGui::EndDisabled();
+
+    // reuses the previous frames while orbiting, perspective camera only
+    if (ImGui::Checkbox("temporal reprojection", &m_reproject))
+      updateFrame();
+
+    // filters float frames on the host while they have few samples
+    ImGui::BeginDisabled(m_format != ANARI_FLOAT32_VEC4);
+    if (ImGui::Checkbox("denoise", &m_denoise))
+      updateFrame();
+    ImGui::EndDisabled();
+
+    if (m_denoise) {
+      ImGui::SliderInt("denoise below samples", &m_denoiseSamples, 1, 64);
+      ImGui::SliderInt("denoiser passes", &m_denoiser.iterations, 1, 5);
+    }
+
+    if (m_strips.size() > 1)
+      ImGui::Checkbox("balance strips", &m_loadBalance);
+
+    // while the camera moves, more frames keep the devices busier but add a
+    // frame of latency each; accumulation always renders one at a time
+    int numFrames = m_numFrames;
+    if (ImGui::SliderInt("frames in flight", &numFrames, 1, 3))
+      setFramesInFlight(numFrames);
+
+    int maxSamples = m_maxSamples;
+    if (ImGui::DragInt("max samples", &maxSamples, 1.f, 0, 65536))
+      setMaxSamples(maxSamples);
+    if (ImGui::IsItemHovered())
+      ImGui::SetTooltip("stop rendering once converged, 0 renders forever");
+
     ImGui::Checkbox("show stats", &m_showOverlay);
     if (ImGui::MenuItem("reset stats")) {
       m_minFL = m_latestFL;
       m_maxFL = m_latestFL;
+      m_stats.clear();
+    }
+
+    if (ImGui::MenuItem("export stats (csv)")) {
+      std::string filename =
+          "frame_stats" + std::to_string(m_statsExportIndex++) + ".csv";
+      if (m_stats.writeCSV(filename.c_str()))
+        printf("frame stats saved to '%s'\n", filename.c_str());
+      else
+        printf("failed to write frame stats to '%s'\n", filename.c_str());
     }
 
     if (ImGui::MenuItem("take screenshot"))
       m_saveNextFrame = true;
 
+    ImGui::BeginDisabled(m_maxSamples == 0);
+    ImGui::Checkbox("record converged frames", &m_recording);
+    ImGui::EndDisabled();
+    if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+      ImGui::SetTooltip(
+          "writes frame00000, frame00001, ... every time the image reaches "
+          "max samples, as .png or for float frames as .exr (.hdr on Windows)");
+    }
+
+    if (ImGui::BeginMenu("camera path")) {
+      if (m_pathRecording) {
+        if (ImGui::MenuItem("stop recording"))
+          stopPathRecording();
+      } else if (ImGui::MenuItem("record", nullptr, false, !m_pathPlaying))
+        startPathRecording();
+
+      const bool idle = !m_pathRecording && !m_pathPlaying;
+
+      const bool havePath = idle && !m_cameraPath.empty();
+
+      if (ImGui::MenuItem("save", nullptr, false, havePath)) {
+        std::string filename =
+            "camera_path" + std::to_string(m_pathExportIndex++) + ".txt";
+        if (m_cameraPath.save(filename.c_str()))
+          printf("camera path saved to '%s'\n", filename.c_str());
+        else
+          printf("failed to write camera path '%s'\n", filename.c_str());
+      }
+
+      if (ImGui::MenuItem("load...", nullptr, false, idle)) {
+        nfdchar_t *outPath = nullptr;
+        nfdfilteritem_t filterItem[1] = {{"Camera Paths", "txt"}};
+        nfdresult_t result = NFD_OpenDialog(&outPath, filterItem, 1, nullptr);
+        if (result == NFD_OKAY) {
+          loadCameraPath(outPath);
+          NFD_FreePath(outPath);
+        } else {
+          printf("NFD Error: %s\n", NFD_GetError());
+        }
+      }
+
+      ImGui::Separator();
+
+      ImGui::Text("%zu keys", m_cameraPath.size());
+      ImGui::DragInt("samples per key", &m_pathSamples, 1.f, 1, 65536);
+
+      if (m_pathPlaying) {
+        if (ImGui::MenuItem("stop playback"))
+          stopPathPlayback();
+      } else if (ImGui::MenuItem("play", nullptr, false, havePath))
+        playCameraPath(m_pathSamples, "camera_path_report.csv");
+
+      ImGui::EndMenu();
+    }
+
     ImGui::Unindent(INDENT_AMOUNT);
     ImGui::Separator();
 
@@ -476,7 +1341,7 @@ void Viewport::ui_contextMenu()
       anari::math::float3 bounds[2];
 
       anariGetProperty(m_device,
-          m_world,
+          m_strips[0].world,
           "bounds",
           ANARI_FLOAT32_BOX3,
           &bounds[0],
@@ -518,9 +1383,13 @@ void Viewport::ui_overlay()
   ImGui::Begin(m_overlayWindowName.c_str(), nullptr, window_flags);
 
   ImGui::Text("viewport: %i x %i", m_viewportSize.x, m_viewportSize.y);
-  ImGui::Text(" samples: %i", m_frameSamples);
+  ImGui::Text("  render: %i x %i", m_renderSize.x, m_renderSize.y);
+  if (m_converged)
+    ImGui::Text(" samples: %i (converged)", m_frameSamples);
+  else
+    ImGui::Text(" samples: %i", m_frameSamples);
 
-  if (m_currentlyRendering)
+  if (!m_inFlight.empty())
     ImGui::Text(" latency: %.2fms", m_latestFL);
   else
     ImGui::Text(" latency: --");
@@ -528,6 +1397,29 @@ void Viewport::ui_overlay()
   ImGui::Text("   (min): %.2fms", m_minFL);
   ImGui::Text("   (max): %.2fms", m_maxFL);
 
+  if (m_frameWriter.pending() > 0)
+    ImGui::Text(" writing: %i frames", m_frameWriter.pending());
+
+  if (m_pathPlaying)
+    ImGui::Text("    path: key %zu / %zu", m_pathKey + 1, m_cameraPath.size());
+  else if (m_pathRecording)
+    ImGui::Text("    path: recording %zu keys", m_cameraPath.size());
+
+  if (m_strips.size() > 1) {
+    ImGui::Separator();
+    for (size_t i = 0; i < m_strips.size(); i++) {
+      auto &s = m_strips[i];
+      ImGui::Text("strip %zu: %4i rows | %.2fms",
+          i,
+          s.rows(),
+          s.duration * 1000);
+    }
+  }
+
+  ImGui::Separator();
+
+  ui_frameStats();
+
   ImGui::Separator();
 
   static bool showCameraInfo = false;
@@ -545,4 +1437,56 @@ void Viewport::ui_overlay()
   ImGui::End();
 }
 
+void Viewport::ui_frameStats()
+{
+  constexpr int HISTOGRAM_BINS = 32;
+
+  ImGui::SetNextItemWidth(150.f);
+  ImGui::Combo(
+      "timing", &m_statsField, "device\0map\0upload\0ui\0present\0\0");
+
+  const auto values = m_stats.snapshot(FrameStats::Field(m_statsField));
+  if (values.empty()) {
+    ImGui::Text("  (no samples)");
+    return;
+  }
+
+  const auto [minIt, maxIt] =
+      std::minmax_element(values.begin(), values.end());
+  const float minValue = *minIt;
+  const float maxValue = std::max(*maxIt, minValue + 1e-3f);
+
+  ImGui::PlotLines("##timeline",
+      values.data(),
+      int(values.size()),
+      0,
+      nullptr,
+      0.f,
+      maxValue,
+      ImVec2(300.f, 60.f));
+
+  std::array<float, HISTOGRAM_BINS> bins{};
+  for (float v : values) {
+    const float t = (v - minValue) / (maxValue - minValue);
+    const int bin = int(t * HISTOGRAM_BINS);
+    bins[std::clamp(bin, 0, HISTOGRAM_BINS - 1)] += 1.f;
+  }
+
+  ImGui::PlotHistogram("##histogram",
+      bins.data(),
+      HISTOGRAM_BINS,
+      0,
+      nullptr,
+      0.f,
+      FLT_MAX,
+      ImVec2(300.f, 60.f));
+
+  ImGui::Text(
+      "  %.2f .. %.2fms | %zu frames", minValue, maxValue, values.size());
+  ImGui::Text("  p50: %.2fms  p95: %.2fms  p99: %.2fms",
+      FrameStats::percentile(values, 0.50f),
+      FrameStats::percentile(values, 0.95f),
+      FrameStats::percentile(values, 0.99f));
+}
+
 } // namespace anari_viewer::windows
@@ -3,7 +3,13 @@
 
 #pragma once
 
+#include "../CameraPath.h"
+#include "../Denoiser.h"
+#include "../FrameStats.h"
+#include "../FrameWriter.h"
 #include "../Orbit.h"
+#include "../Reprojector.h"
+#include "../ToneMapper.h"
 #include "../ui_anari.h"
 // glad
 #include "glad/glad.h"
@@ -14,20 +20,31 @@
 #include <anari/anari_cpp.hpp>
 // std
 #include <array>
+#include <chrono>
+#include <deque>
+#include <functional>
 #include <limits>
+#include <optional>
+#include <string>
+#include <vector>
 
 #include "Window.h"
 
+#include "common.h"
+
 namespace my_viewer::windows {
 
 struct Viewport : public Window
 {
   Viewport(anari::Device device, const char *name = "Viewport");
+  Viewport(std::vector<anari::Device> devices, const char *name = "Viewport");
   ~Viewport();
 
   void buildUI() override;
 
   void setWorld(anari::World world = nullptr, bool resetCameraView = true);
+  void setWorlds(
+      std::vector<anari::World> worlds, bool resetCameraView = true);
 
   void setManipulator(manipulators::Orbit *m);
 
@@ -35,33 +52,147 @@ struct Viewport : public Window
 
   anari::Device device() const;
 
+  // host side timings of the last UI frame, recorded with the next sample
+  void setHostTimings(float uiMS, float presentMS);
+
+  // Finished frames are reported by ANARI_KHR_FRAME_COMPLETION_CALLBACK and
+  // wake the UI thread with glfwPostEmptyEvent() instead of being polled, so
+  // the main loop may block in glfwWaitEvents(). Only enable this when every
+  // device advertises the extension.
+  void useCompletionCallbacks(bool enable);
+  bool usesCompletionCallbacks() const;
+
+  // Rendering stops once the frame holds maxSamples samples (0 renders
+  // forever) and resumes when anything the viewport knows about changes.
+  // Changes made elsewhere, like lights, have to restart it explicitly.
+  void setMaxSamples(int maxSamples);
+  bool converged() const;
+  void restartAccumulation();
+
+  // The denoiser is guided by the albedo and normal channels when the devices
+  // advertise ANARI_KHR_FRAME_CHANNEL_ALBEDO and _NORMAL, by color and depth
+  // alone otherwise.
+  void setGuideChannels(bool albedo, bool normal);
+
+  // While recording, every change of the manipulator is appended to the
+  // camera path. Playback moves the manipulator through the keys in order
+  // regardless of their times, renders each until it holds samplesPerKey
+  // samples and writes the latency of every key to reportFile at the end.
+  using CameraPathCallback = std::function<void()>;
+  void startPathRecording();
+  void stopPathRecording();
+  bool loadCameraPath(const char *fileName);
+  void playCameraPath(int samplesPerKey, std::string reportFile);
+  void stopPathPlayback();
+  bool playingCameraPath() const;
+  // called when a playback ends, after the report was written
+  void setPathFinishedCallback(CameraPathCallback cb);
+
  private:
+  // A horizontal strip of the viewport rendered by its own device. With a
+  // single device there is one strip covering the whole viewport.
+  struct Strip
+  {
+    // one of the frames rendered round robin
+    struct Slot
+    {
+      anari::Frame frame{nullptr};
+      int renderRowBegin{0}; // rowBegin when the frame was started
+      bool rendering{false};
+      bool completed{false}; // reported by the completion callback
+    };
+
+    anari::Device device{nullptr};
+    std::vector<Slot> slots;
+    anari::World world{nullptr};
+
+    anari::Camera perspCamera{nullptr};
+    anari::Camera orthoCamera{nullptr};
+
+    std::vector<anari::Renderer> renderers;
+
+    float share{1.f}; // fraction of the frame height
+    int rowBegin{0};
+    int rowEnd{0};
+    float duration{0.f};
+
+    int rows() const;
+  };
+
+  // Interactive frames are rendered round robin so the devices work on the
+  // next frame while the previous one is mapped and uploaded; accumulating
+  // frames render one at a time into slot 0. All strips render the same slot,
+  // m_inFlight lists the slots in flight, oldest first.
+  struct InFlight
+  {
+    int slot{0};
+    anari::math::int2 size{0, 0};
+    unsigned generation{0};
+    ReprojectionView view; // camera the frame was started with
+  };
+
+  // Frames post-processed on the host are gathered here from the strips and
+  // uploaded as a whole once every stage ran. Channels a stage does not need
+  // stay empty.
+  struct HostFrame
+  {
+    bool isFloat{false};
+    std::vector<uint8_t> color;
+    std::vector<float> depth;
+    std::vector<float> albedo; // RGB
+    std::vector<float> normal; // XYZ
+  };
+
   void reshape(anari::math::int2 newWindowSize);
 
   void startNewFrame();
   void updateFrame();
+  void updateInteraction();
   void updateCamera(bool force = false);
+  void commitCamera();
   void updateImage();
+  void fillPipeline();
+  void presentFrame(const InFlight &frame);
+  void uploadStrip(Strip &s, Strip::Slot &slot);
+  void postProcessFrame(const ReprojectionView &view);
+  void setFramesInFlight(int numFrames);
+  void waitForFrames();
+  // moves strip shares towards the device throughput, true if rows moved
+  bool rebalanceStrips();
+  void saveScreenshot();
+  void writeCapture();
   void cancelFrame();
+  void applyPathKey();
+
+  static void frameCompleted(
+      const void *userData, ANARIDevice device, ANARIFrame frame);
 
   void ui_handleInput();
   void ui_contextMenu();
   void ui_overlay();
+  void ui_frameStats();
 
   // Data /////////////////////////////////////////////////////////////////////
 
   anari::math::float2 m_previousMouse{-1.f, -1.f};
   bool m_mouseRotating{false};
   bool m_manipulating{false};
-  bool m_currentlyRendering{true};
+  bool m_wasManipulating{false};
   bool m_contextMenuVisible{false};
   bool m_frameCancelled{false};
-  bool m_saveNextFrame{false};
-  int m_screenshotIndex{0};
+
+  // progressive refinement: render at 1/N resolution without accumulation
+  // while the camera is being manipulated, full resolution otherwise
+  bool m_progressiveRefinement{true};
+  bool m_interactiveFrame{false};
+  int m_interactiveDownscale{4};
 
   bool m_showOverlay{true};
   int m_frameSamples{0};
   bool m_useOrthoCamera{false};
+  // camera state changed since the camera was last committed
+  bool m_perspCameraStale{true};
+  bool m_orthoCameraStale{true};
 
   float m_fov{40.f};
 
@@ -69,17 +200,31 @@ struct Viewport : public Window
 
   anari::DataType m_format{ANARI_UFIXED8_RGBA_SRGB};
 
-  anari::Device m_device{nullptr};
-  anari::Frame m_frame{nullptr};
-  anari::World m_world{nullptr};
+  anari::Device m_device{nullptr}; // primary device, owns m_strips[0]
+  std::vector<Strip> m_strips;
+  bool m_loadBalance{true};
+
+  std::deque<InFlight> m_inFlight;
+  int m_numFrames{2}; // interactive frames in flight, one slot more exists
+  int m_nextSlot{0};
+
+  // pushed from device threads by frameCompleted(), drained in updateImage()
+  bool m_completionCallbacks{false};
+  mpsc_queue<anari::Frame, 64> m_completedFrames;
 
-  anari::Camera m_perspCamera{nullptr};
-  anari::Camera m_orthoCamera{nullptr};
+  // only frames started in the current generation count toward convergence,
+  // restartAccumulation() begins a new one
+  int m_maxSamples{1024};
+  bool m_converged{false};
+  unsigned m_generation{0};
+  int m_presentedFrames{0};
 
   std::vector<std::string> m_rendererNames;
-  std::vector<ui::ParameterList> m_rendererParameters;
-  std::vector<anari::Renderer> m_renderers;
+  // filled from the introspection cache when the parameters menu opens
+  std::vector<std::optional<ui::ParameterList>> m_rendererParameters;
   int m_currentRenderer{0};
+  // renderer parameter edits, committed when the next frame starts
+  ui::ParameterBatch m_pendingParameters;
 
   // camera manipulator
 
@@ -91,13 +236,64 @@ struct Viewport : public Window
   // OpenGL + display
 
   GLuint m_framebufferTexture{0};
+  // float frames go through the tone mapper into m_framebufferTexture
+  ToneMapper m_toneMapper;
+  bool m_toneMapStale{false};
   anari::math::int2 m_viewportSize{1920, 1080};
   anari::math::int2 m_renderSize{1920, 1080};
+  anari::math::int2 m_frameSize{1920, 1080};
+  anari::math::int2 m_textureSize{1920, 1080};
 
   float m_latestFL{1.f};
   float m_minFL{std::numeric_limits<float>::max()};
   float m_maxFL{-std::numeric_limits<float>::max()};
 
+  // reprojection and denoising: while the camera moves, frames are blended
+  // with the previous result warped into the new view using the depth
+  // channel, float frames with few samples are denoised after that
+  bool m_reproject{false};
+  bool m_denoise{false};
+  int m_denoiseSamples{8}; // frames with fewer samples are denoised
+  bool m_albedoChannel{false};
+  bool m_normalChannel{false};
+  bool m_reprojectFrame{false};
+  bool m_denoiseFrame{false};
+  HostFrame m_hostFrame;
+  Reprojector m_reprojector;
+  Denoiser m_denoiser;
+
+  // frame statistics, plotted in the overlay and exported as CSV
+  FrameStats m_stats;
+  FrameSample m_pendingSample;
+  int m_statsField{FrameStats::DEVICE};
+  int m_statsExportIndex{0};
+
+  // screenshots and recording: the presented frame is copied here from the
+  // mapped strips when it is saved, and encoded and written to disk in the
+  // background; record mode saves it every time the image converges
+  bool m_saveNextFrame{false};
+  int m_screenshotIndex{0};
+  bool m_recording{false};
+  int m_recordIndex{0};
+  bool m_captureFrame{false};
+  bool m_recordFrame{false};
+  std::optional<FrameWriter::Image> m_capture;
+  FrameWriter m_frameWriter;
+
+  // camera path recording and playback, playback overrides m_maxSamples
+  CameraPath m_cameraPath;
+  bool m_pathRecording{false};
+  std::chrono::steady_clock::time_point m_pathRecordStart;
+  bool m_pathPlaying{false};
+  size_t m_pathKey{0};
+  int m_pathSamples{64};
+  int m_pathSavedMaxSamples{0};
+  std::chrono::steady_clock::time_point m_pathKeyStart;
+  std::vector<KeyTiming> m_pathTimings;
+  std::string m_pathReport;
+  CameraPathCallback m_pathFinishedCallback;
+  int m_pathExportIndex{0};
+
   std::string m_overlayWindowName;
   std::string m_contextMenuName;
 };
@@ -1,10 +1,24 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
 #include <iostream>
+#include <string>
 
 bool           g_verbose          = false;
 bool           g_useDefaultLayout = true;
 bool           g_enableDebug      = false;
 std::string    g_libraryName      = "environment";
 const char*    g_traceDir         = nullptr;
+int            g_numDevices       = 1;
+const char*    g_profileFile      = nullptr;
+size_t         g_sceneCacheMB     = 1024;
+size_t         g_sceneCacheSize   = 8;
+const char*    g_parameterCache   = nullptr;
+int            g_maxSamples       = -1; // the viewport's default
+const char*    g_sceneName        = nullptr;
+const char*    g_cameraPath       = nullptr;
+int            g_pathSamples      = 64;
+const char*    g_pathReport       = "camera_path_report.csv";
 
 int entry_point();
 int ENTRY_POINT();
@@ -18,7 +32,15 @@ static void printUsage()
 	std::cout << "./anariViewer [{--help|-h}]\n"
 			  << "   [{--verbose|-v}] [{--debug|-g}]\n"
 			  << "   [{--library|-l} <ANARI library>]\n"
-			  << "   [{--trace|-t} <directory>]\n";
+			  << "   [{--trace|-t} <directory, one subdirectory per split device>]\n"
+			  << "   [{--split|-s} <number of devices>]\n"
+			  << "   [{--profile|-p} <trace.json>]\n"
+			  << "   [--sceneCacheMB <megabytes>] [--sceneCacheSize <scenes>]\n"
+			  << "   [--parameterCache <file>]\n"
+			  << "   [--maxSamples <samples, 0 renders forever, 1024 by default>]\n"
+			  << "   [--scene <category/scene>]\n"
+			  << "   [--cameraPath <path file>] [--pathSamples <samples per key>]\n"
+			  << "   [--pathReport <report.csv>]\n";
 }
 
 static void parseCommandLine(int argc, char *argv[])
@@ -38,6 +60,26 @@ static void parseCommandLine(int argc, char *argv[])
 			g_enableDebug = true;
 		else if (arg == "--trace" || arg == "-t")
 			g_traceDir = argv[++i];
+		else if (arg == "--split" || arg == "-s")
+			g_numDevices = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--profile" || arg == "-p")
+			g_profileFile = argv[++i];
+		else if (arg == "--sceneCacheMB")
+			g_sceneCacheMB = size_t(std::max(0, std::atoi(argv[++i])));
+		else if (arg == "--sceneCacheSize")
+			g_sceneCacheSize = size_t(std::max(1, std::atoi(argv[++i])));
+		else if (arg == "--parameterCache")
+			g_parameterCache = argv[++i];
+		else if (arg == "--maxSamples")
+			g_maxSamples = std::max(0, std::atoi(argv[++i]));
+		else if (arg == "--scene")
+			g_sceneName = argv[++i];
+		else if (arg == "--cameraPath")
+			g_cameraPath = argv[++i];
+		else if (arg == "--pathSamples")
+			g_pathSamples = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--pathReport")
+			g_pathReport = argv[++i];
 	}
 }
 
@@ -3,6 +3,8 @@
 //
 
 #include "anari_viewer/Orbit.h"
+#include "anari_viewer/SceneBuilder.h"
+#include "anari_viewer/SceneCache.h"
 #include "anari_viewer/ui_anari.h"
 #include "anari_viewer/windows/Viewport.h"
 
@@ -18,20 +20,41 @@
 #include <glad/glad.h>
 // std
 #include <chrono>
+#include <filesystem>
+#include <memory>
+#include <unordered_map>
 
 #include "anari_viewer/windows/LightsEditor.h"
 #include "anari_viewer/windows/SceneSelector.h"
 
+#include "common.h"
+
 extern bool        g_verbose;
 extern bool        g_useDefaultLayout;
 extern bool        g_enableDebug;
 extern std::string g_libraryName;
 extern const char* g_traceDir;
+extern int         g_numDevices;
+extern const char* g_profileFile;
+extern size_t      g_sceneCacheMB;
+extern size_t      g_sceneCacheSize;
+extern const char* g_parameterCache;
+extern int         g_maxSamples;
+extern const char* g_sceneName;
+extern const char* g_cameraPath;
+extern int         g_pathSamples;
+extern const char* g_pathReport;
 
 struct AppState {
 	// anari
 	anari::Library debug = nullptr;
-	anari::Device  device{ nullptr };
+	// one device per viewport strip, devices[0] is the primary device
+	std::vector<anari::Device> devices;
+	// devices report finished frames through a callback instead of being polled
+	bool frameCompletionCallback = false;
+	// guide channels for the denoiser
+	bool albedoChannel = false;
+	bool normalChannel = false;
 	// camera
 	my_viewer::manipulators::Orbit manipulator;
 	// window
@@ -45,10 +68,26 @@ struct AppState {
 	std::chrono::time_point<std::chrono::steady_clock> lastFrameEndTime;
 	std::chrono::time_point<std::chrono::steady_clock> lastFrameStartTime;
 	bool windowResized = true;
+	// UI frames still drawn after an event before a converged viewport lets the loop sleep
+	int settleFrames = 0;
 
 	// remove
-	using WindowArray = std::vector<my_viewer::windows::Window*>;
+	using WindowArray = std::vector<std::unique_ptr<my_viewer::windows::Window>>;
 	WindowArray windows;
+	my_viewer::windows::Viewport* viewport = nullptr;
+	my_viewer::windows::LightsEditor* lightsEditor = nullptr;
+	my_viewer::windows::SceneSelector* sceneSelector = nullptr;
+
+	// scenes are built off the UI thread and swapped in by draw_scene()
+	std::unique_ptr<my_viewer::SceneBuilder> sceneBuilder;
+	// owns every built scene, switching back to a cached one skips the build
+	std::unique_ptr<my_viewer::SceneCache> sceneCache;
+	// parameter hash of a freshly built scene, keyed by "category/scene"
+	std::unordered_map<std::string, size_t> defaultParametersHash;
+
+	// a camera path given on the command line plays once the first scene is in use,
+	// the viewer quits when it ends
+	bool benchmarkPending = false;
 } static g_AppState;
 
 extern const char* getDefaultUILayout ();
@@ -74,15 +113,26 @@ static void status_callback (const void* userData, ANARIDevice device, ANARIObje
 }
 
 void init_ANARI() {
+	TRACE_SCOPE("init_ANARI");
+
 	auto library =
 		anariLoadLibrary(g_libraryName.c_str(), status_callback, &g_verbose);
 	if (library == nullptr) {
 		throw std::runtime_error("Failed to load ANARI library");
 	}
-	anari::Device dev = anariNewDevice(library, "default");
+	for (int i = 0; i < g_numDevices; i++) {
+		g_AppState.devices.push_back(anariNewDevice(library, "default"));
+	}
+
+	anari::Extensions extensions = anari::extension::getDeviceExtensionStruct(library, "default");
+	g_AppState.frameCompletionCallback = extensions.ANARI_KHR_FRAME_COMPLETION_CALLBACK;
+	g_AppState.albedoChannel = extensions.ANARI_KHR_FRAME_CHANNEL_ALBEDO;
+	g_AppState.normalChannel = extensions.ANARI_KHR_FRAME_CHANNEL_NORMAL;
 
 	anariUnloadLibrary(library);
 
+	anari::Device dev = g_AppState.devices[0];
+
 	//   if (g_verbose)
 	//     anari::setParameter(dev, dev, "glDebug", true);
 	//
@@ -92,14 +142,25 @@ void init_ANARI() {
 	//   anari::setParameter(dev, dev, "glAPI", "OpenGL");
 	// #endif
 
+	// split devices each render their own strip with their own frame sizes, so
+	// every device gets its own trace in <traceDir>/device<i>
 	if (g_traceDir != nullptr) {
-		anari::setParameter(dev, dev, "traceDir", g_traceDir);
-		anari::setParameter(dev, dev, "traceMode", "code");
+		for (size_t i = 0; i < g_AppState.devices.size(); i++) {
+			anari::Device d = g_AppState.devices[i];
+			std::filesystem::path dir = g_traceDir;
+			if (g_AppState.devices.size() > 1) {
+				dir /= "device" + std::to_string(i);
+				std::error_code error;
+				std::filesystem::create_directories(dir, error);
+			}
+			anari::setParameter(d, d, "traceDir", dir.string().c_str());
+			anari::setParameter(d, d, "traceMode", "code");
+		}
 	}
 
-	anari::commitParameters(dev, dev);
-
-	g_AppState.device = dev;
+	for (auto d : g_AppState.devices) {
+		anari::commitParameters(d, d);
+	}
 }
 
 void init_GLFW() {
@@ -144,6 +205,17 @@ void init_ImGUI_GLFW_OpenGL() {
 	ImGui_ImplOpenGL2_Init();
 }
 
+static void use_scene(const my_viewer::BuiltScene &scene) {
+	g_AppState.viewport->setWorlds(scene.worlds, true);
+	g_AppState.lightsEditor->setWorlds(scene.worlds);
+	g_AppState.sceneSelector->setScenes(scene.scenes);
+
+	if (g_AppState.benchmarkPending) {
+		g_AppState.benchmarkPending = false;
+		g_AppState.viewport->playCameraPath(g_pathSamples, g_pathReport);
+	}
+}
+
 void init_ImGUI_and_UI() {
 	// imgui-styling
 	ImGuiIO &io = ImGui::GetIO();
@@ -170,28 +242,48 @@ void init_ImGUI_and_UI() {
 
 	my_viewer::ui::init(); // native-file-dialog init
 
+	// object parameters are introspected lazily, a saved cache skips even that
+	if (g_parameterCache != nullptr) {
+		my_viewer::ui::loadParameterCache(g_parameterCache);
+	}
+
 	if (g_useDefaultLayout) {
 		ImGui::LoadIniSettingsFromMemory(getDefaultUILayout());
 	}
 
 	// build ui
-	auto *viewport = new my_viewer::windows::Viewport(g_AppState.device, "Viewport");
+	auto *viewport = new my_viewer::windows::Viewport(g_AppState.devices, "Viewport");
 	viewport->setManipulator(&g_AppState.manipulator);
+	viewport->useCompletionCallbacks(g_AppState.frameCompletionCallback);
+	if (g_maxSamples >= 0) {
+		viewport->setMaxSamples(g_maxSamples);
+	}
+	viewport->setGuideChannels(g_AppState.albedoChannel, g_AppState.normalChannel);
 
-	auto *leditor = new my_viewer::windows::LightsEditor(g_AppState.device);
+	auto *leditor = new my_viewer::windows::LightsEditor(g_AppState.devices);
+	// the viewport only sees its own changes, edits to the world wake it up
+	leditor->setUpdateCallback([=]() { viewport->restartAccumulation(); });
+
+	g_AppState.sceneBuilder = std::make_unique<my_viewer::SceneBuilder>(g_AppState.devices);
+	g_AppState.sceneCache = std::make_unique<my_viewer::SceneCache>(g_sceneCacheMB << 20, g_sceneCacheSize);
 
 	auto *sselector = new my_viewer::windows::SceneSelector();
+	g_AppState.sceneSelector = sselector;
+	sselector->setUpdateCallback([=]() { viewport->restartAccumulation(); });
 	sselector->setCallback([=](const char *category, const char *scene) {
-	  try {
-		auto s = anari::scenes::createScene(g_AppState.device, category, scene);
-		anari::scenes::commit(s);
-		auto w = anari::scenes::getWorld(s);
-		viewport->setWorld(w, true);
-		leditor->setWorlds({w});
-		sselector->setScene(s);
-	  } catch (const std::runtime_error &e) {
-		printf("%s\n", e.what());
-	  }
+		auto &cache = *g_AppState.sceneCache;
+		// edits committed from the selector changed the current scene in place
+		cache.rekeyInUse(sselector->committedParametersHash());
+
+		auto hash = g_AppState.defaultParametersHash.find(std::string(category) + "/" + scene);
+		if (hash != g_AppState.defaultParametersHash.end()) {
+			if (auto *cached = cache.acquire(my_viewer::SceneCache::key(category, scene, hash->second))) {
+				g_AppState.sceneBuilder->cancel();
+				use_scene(*cached);
+				return;
+			}
+		}
+		g_AppState.sceneBuilder->request(category, scene);
 	});
 
 	AppState::WindowArray windows;
@@ -200,6 +292,51 @@ void init_ImGUI_and_UI() {
 	windows.emplace_back(sselector);
 
 	g_AppState.windows = std::move(windows);
+	g_AppState.viewport = viewport;
+	g_AppState.lightsEditor = leditor;
+
+	if (g_cameraPath != nullptr && viewport->loadCameraPath(g_cameraPath)) {
+		g_AppState.benchmarkPending = true;
+		viewport->setPathFinishedCallback([]() {
+			glfwSetWindowShouldClose(g_AppState.nativeWindow, 1);
+			// a converged viewport may be waiting for events
+			glfwPostEmptyEvent();
+		});
+	}
+
+	// "category/scene" from the command line, built like a pick in the selector
+	if (g_sceneName != nullptr) {
+		const std::string name = g_sceneName;
+		const size_t slash = name.find('/');
+		if (slash == std::string::npos) {
+			fprintf(stderr, "--scene expects <category>/<scene>, got '%s'\n", g_sceneName);
+		} else {
+			g_AppState.sceneBuilder->request(name.substr(0, slash).c_str(), name.substr(slash + 1).c_str());
+		}
+	}
+}
+
+// swap a finished background build in, all windows switch in the same frame
+static void update_scene() {
+	auto &builder = *g_AppState.sceneBuilder;
+
+	auto built = builder.poll();
+
+	if (builder.busy()) {
+		g_AppState.sceneSelector->setBuildProgress(builder.progress(), builder.sceneName());
+	} else {
+		g_AppState.sceneSelector->setBuildProgress(-1.f);
+	}
+
+	if (!built || built->scenes.empty()) {
+		return;
+	}
+
+	const size_t hash = my_viewer::ui::hashParameters(anari::scenes::getParameters(built->scenes[0]));
+	g_AppState.defaultParametersHash[built->category + "/" + built->name] = hash;
+
+	const std::string key = my_viewer::SceneCache::key(built->category, built->name, hash);
+	use_scene(g_AppState.sceneCache->insert(key, std::move(*built)));
 }
 
 bool window_condition() {
@@ -207,12 +344,32 @@ bool window_condition() {
 
 	g_AppState.lastFrameStartTime = g_AppState.lastFrameEndTime;
 	g_AppState.lastFrameEndTime = std::chrono::steady_clock::now();
-	glfwPollEvents();
+
+	// a converged viewport renders nothing until input arrives, ImGui needs a couple of
+	// frames after an event to settle hover and focus state before the loop sleeps again
+	const bool idle = g_AppState.viewport->converged() && !g_AppState.sceneBuilder->busy()
+	                  && !g_AppState.lightsEditor->loading();
+	if (idle && g_AppState.settleFrames == 0) {
+		glfwWaitEvents();
+		g_AppState.settleFrames = 2;
+		return should_close;
+	}
+	g_AppState.settleFrames = idle ? g_AppState.settleFrames - 1 : 2;
+
+	// finished frames post an empty event, so the loop only has to spin when it polls the
+	// device, the timeout keeps progress of background scene and HDRI loads moving
+	if (g_AppState.viewport->usesCompletionCallbacks()) {
+		glfwWaitEventsTimeout(0.1);
+	} else {
+		glfwPollEvents();
+	}
 
 	return should_close;
 }
 
 void draw_ui() {
+	TRACE_SCOPE("draw_ui");
+
 	ImGui_ImplOpenGL2_NewFrame();
 	ImGui_ImplGlfw_NewFrame();
 
@@ -263,12 +420,20 @@ void draw_ui() {
 }
 
 void draw_scene() {
-	for (auto *window : g_AppState.windows) {
+	TRACE_SCOPE("draw_scene");
+
+	update_scene();
+	// collapsed windows are not drawn, finished loads still have to land
+	g_AppState.lightsEditor->update();
+
+	for (auto &window : g_AppState.windows) {
 		window->renderUI();
 	}
 }
 
 void present() {
+	TRACE_SCOPE("present");
+
 	ImGui::End();
 
 	ImGui::Render();
@@ -282,7 +447,17 @@ void present() {
 }
 
 void cleanup() {
+	g_AppState.sceneBuilder.reset();
+	g_AppState.viewport = nullptr;
+	g_AppState.lightsEditor = nullptr;
+	g_AppState.sceneSelector = nullptr;
+	// the viewport waits for its frames and pending screenshot writes here
 	g_AppState.windows.clear();
+	g_AppState.sceneCache.reset();
+
+	if (g_parameterCache != nullptr && !my_viewer::ui::saveParameterCache(g_parameterCache)) {
+		fprintf(stderr, "[WARN ] could not write parameter cache %s\n", g_parameterCache);
+	}
 
 	ImGui_ImplOpenGL2_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
@@ -293,18 +468,40 @@ void cleanup() {
 	glfwTerminate();
 
 	g_AppState.nativeWindow = nullptr;
+
+	if (g_profileFile != nullptr) {
+		if (TRACE_WRITE(g_profileFile)) {
+			printf("cpu trace saved to '%s'\n", g_profileFile);
+		} else {
+			printf("failed to write cpu trace to '%s'\n", g_profileFile);
+		}
+	}
 }
 
 int ENTRY_POINT() {
+	TRACE_ENABLE(g_profileFile != nullptr);
+
 	init_ANARI();
 	init_GLFW();
 	init_ImGUI_GLFW_OpenGL();
 	init_ImGUI_and_UI();
 
+	using clock = std::chrono::steady_clock;
+	auto milliseconds = [](clock::time_point from, clock::time_point to) {
+		return std::chrono::duration<float, std::milli>(to - from).count();
+	};
+
 	while (window_condition()) {
+		const auto uiStart = clock::now();
 		draw_ui();
 		draw_scene();
+
+		const auto presentStart = clock::now();
 		present();
+
+		const auto presentEnd = clock::now();
+		g_AppState.viewport->setHostTimings(milliseconds(uiStart, presentStart),
+		                                    milliseconds(presentStart, presentEnd));
 	}
 
 	cleanup();
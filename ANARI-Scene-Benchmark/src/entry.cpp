@@ -0,0 +1,253 @@
+#include <anari/anari_cpp.hpp>
+#include <anari/anari_cpp/ext/linalg.h>
+#include <anari_test_scenes.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if _WIN32
+#include <Windows.h>
+#include <psapi.h>
+#undef min
+#undef max
+#elif __APPLE__
+#include <sys/resource.h>
+#endif
+
+#include "common.h"
+#include "report.h"
+
+extern bool        g_verbose;
+extern std::string g_libraryName;
+extern std::string g_categoryName;
+extern std::string g_sceneName;
+extern int         g_width;
+extern int         g_height;
+extern int         g_warmupFrames;
+extern int         g_frames;
+extern std::string g_outputFile;
+extern const char* g_baselineFile;
+extern float       g_tolerance;
+
+using clock_type = std::chrono::steady_clock;
+
+static float milliseconds_since(clock_type::time_point start) {
+	return std::chrono::duration<float, std::milli>(clock_type::now() - start).count();
+}
+
+static void status_callback (const void* userData, ANARIDevice device, ANARIObject source,
+							 ANARIDataType sourceType, ANARIStatusSeverity severity,
+							 ANARIStatusCode code, const char* message) {
+	const bool verbose = userData ? *(const bool*)userData : false;
+	if (severity == ANARI_SEVERITY_FATAL_ERROR) {
+		fprintf (stderr, "[FATAL][%p] %s\n", source, message);
+		std::exit (1);
+	} else if (severity == ANARI_SEVERITY_ERROR) {
+		fprintf (stderr, "[ERROR][%p] %s\n", source, message);
+	} else if (severity == ANARI_SEVERITY_WARNING) {
+		fprintf (stderr, "[WARN ][%p] %s\n", source, message);
+	} else if (verbose && severity == ANARI_SEVERITY_PERFORMANCE_WARNING) {
+		fprintf (stderr, "[PERF ][%p] %s\n", source, message);
+	} else if (verbose && severity == ANARI_SEVERITY_INFO) {
+		fprintf (stderr, "[INFO ][%p] %s\n", source, message);
+	} else if (verbose && severity == ANARI_SEVERITY_DEBUG) {
+		fprintf (stderr, "[DEBUG][%p] %s\n", source, message);
+	}
+}
+
+// Linux keeps a high water mark of the resident set that can be reset, so every scene gets
+// its own peak; elsewhere the peak of the whole process so far is reported
+static bool reset_peak_rss() {
+#if __linux__
+	if (FILE* clearRefs = fopen("/proc/self/clear_refs", "w")) {
+		const bool reset = fputs("5", clearRefs) >= 0;
+		fclose(clearRefs);
+		return reset;
+	}
+#endif
+	return false;
+}
+
+static size_t peak_rss_bytes() {
+#if _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return counters.PeakWorkingSetSize;
+	}
+#elif __linux__
+	size_t kilobytes = 0;
+	if (FILE* status = fopen("/proc/self/status", "r")) {
+		char line[256];
+		while (fgets(line, sizeof(line), status)) {
+			if (sscanf(line, "VmHWM: %zu kB", &kilobytes) == 1) {
+				break;
+			}
+		}
+		fclose(status);
+	}
+	return kilobytes * 1024;
+#elif __APPLE__
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		return size_t(usage.ru_maxrss); // bytes on macOS
+	}
+#endif
+	return 0;
+}
+
+static SceneResult run_scene(anari::Device d, anari::Renderer renderer, const std::string& category, const std::string& name) {
+	TRACE_SCOPE("run_scene");
+
+	SceneResult result;
+	result.category = category;
+	result.scene = name;
+
+	reset_peak_rss();
+
+	anari::scenes::SceneHandle scene = nullptr;
+	try {
+		auto start = clock_type::now();
+		scene = anari::scenes::createScene(d, category.c_str(), name.c_str());
+		result.createMS = milliseconds_since(start);
+
+		start = clock_type::now();
+		anari::scenes::commit(scene);
+		result.commitMS = milliseconds_since(start);
+	} catch (const std::runtime_error& e) {
+		fprintf(stderr, "%s/%s: %s\n", category.c_str(), name.c_str(), e.what());
+		if (scene != nullptr) {
+			anari::scenes::release(scene);
+		}
+		return result;
+	}
+
+	// the first frame includes whatever the device defers to it, like acceleration structures
+	const auto firstFrameStart = clock_type::now();
+
+	auto world = anari::scenes::getWorld(scene);
+
+	// every scene is framed the same way from its bounds, so runs stay comparable
+	anari::math::float3 bounds[2] = {{0.f, 0.f, 0.f}, {1.f, 1.f, 1.f}};
+	anariGetProperty(d, world, "bounds", ANARI_FLOAT32_BOX3, &bounds[0], sizeof(bounds), ANARI_WAIT);
+	const auto center = 0.5f * (bounds[0] + bounds[1]);
+	const float distance = 1.25f * linalg::length(bounds[1] - bounds[0]);
+	const auto direction = linalg::normalize(anari::math::float3(-1.f, -0.5f, -1.f));
+
+	auto camera = anari::newObject<anari::Camera>(d, "perspective");
+	anari::setParameter(d, camera, "aspect", float(g_width) / float(g_height));
+	anari::setParameter(d, camera, "position", center - distance * direction);
+	anari::setParameter(d, camera, "direction", direction);
+	anari::setParameter(d, camera, "up", anari::math::float3(0.f, 1.f, 0.f));
+	anari::commitParameters(d, camera);
+
+	auto frame = anari::newObject<anari::Frame>(d);
+	anari::setParameter(d, frame, "size", anari::math::uint2(g_width, g_height));
+	anari::setParameter(d, frame, "channel.color", ANARI_UFIXED8_RGBA_SRGB);
+	anari::setParameter(d, frame, "world", world);
+	anari::setParameter(d, frame, "camera", camera);
+	anari::setParameter(d, frame, "renderer", renderer);
+	anari::commitParameters(d, frame);
+
+	anari::render(d, frame);
+	anari::wait(d, frame);
+	result.firstFrameMS = milliseconds_since(firstFrameStart);
+
+	for (int i = 0; i < g_warmupFrames; i++) {
+		anari::render(d, frame);
+		anari::wait(d, frame);
+	}
+
+	std::vector<float> frameTimes;
+	for (int i = 0; i < g_frames; i++) {
+		const auto start = clock_type::now();
+		anari::render(d, frame);
+		anari::wait(d, frame);
+		frameTimes.push_back(milliseconds_since(start));
+	}
+
+	std::sort(frameTimes.begin(), frameTimes.end());
+	const size_t n = frameTimes.size();
+	result.frameMS = frameTimes[n / 2];
+	result.frameP95MS = frameTimes[std::min(n - 1, size_t(std::ceil(0.95f * n)) - 1)];
+
+	result.peakRSSMB = float(peak_rss_bytes()) / float(1 << 20);
+	result.ok = true;
+
+	anari::release(d, frame);
+	anari::release(d, camera);
+	anari::scenes::release(scene);
+
+	return result;
+}
+
+int ENTRY_POINT() {
+	auto library = anariLoadLibrary(g_libraryName.c_str(), status_callback, &g_verbose);
+	if (library == nullptr) {
+		throw std::runtime_error("Failed to load ANARI library");
+	}
+
+	anari::Device d = anariNewDevice(library, "default");
+	anari::commitParameters(d, d);
+
+	auto renderer = anari::newObject<anari::Renderer>(d, "default");
+	anari::commitParameters(d, renderer);
+
+	if (!reset_peak_rss()) {
+		printf("peak RSS cannot be reset here, it is the process peak up to each scene\n");
+	}
+
+	printf("%-40s %10s %10s %10s %10s %10s %10s\n",
+		"scene", "create ms", "commit ms", "first ms", "frame ms", "p95 ms", "rss MB");
+
+	std::vector<SceneResult> results;
+	for (const auto& category : anari::scenes::getAvailableSceneCategories()) {
+		if (!g_categoryName.empty() && category != g_categoryName) {
+			continue;
+		}
+		for (const auto& name : anari::scenes::getAvailableSceneNames(category.c_str())) {
+			if (!g_sceneName.empty() && name != g_sceneName) {
+				continue;
+			}
+
+			const SceneResult r = run_scene(d, renderer, category, name);
+			const std::string label = category + "/" + name;
+			if (r.ok) {
+				printf("%-40s %10.2f %10.2f %10.2f %10.2f %10.2f %10.1f\n",
+					label.c_str(), r.createMS, r.commitMS, r.firstFrameMS, r.frameMS, r.frameP95MS, r.peakRSSMB);
+			} else {
+				printf("%-40s failed\n", label.c_str());
+			}
+			results.push_back(r);
+		}
+	}
+
+	anari::release(d, renderer);
+	anari::release(d, d);
+	anariUnloadLibrary(library);
+
+	if (!write_report(g_outputFile.c_str(), results)) {
+		fprintf(stderr, "failed to write report '%s'\n", g_outputFile.c_str());
+		return 1;
+	}
+	printf("report saved to '%s'\n", g_outputFile.c_str());
+
+	if (g_baselineFile == nullptr) {
+		return 0;
+	}
+
+	std::vector<SceneResult> baseline;
+	if (!read_report(g_baselineFile, baseline)) {
+		fprintf(stderr, "failed to read baseline '%s'\n", g_baselineFile);
+		return 1;
+	}
+
+	printf("compared to '%s' (tolerance %.0f%%):\n", g_baselineFile, 100.f * g_tolerance);
+	const int regressions = compare_reports(baseline, results, g_tolerance);
+	printf("%i regressions\n", regressions);
+	return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+bool           g_verbose          = false;
+std::string    g_libraryName      = "environment";
+std::string    g_categoryName     = ""; // empty runs every category
+std::string    g_sceneName        = ""; // empty runs every scene
+int            g_width            = 1024;
+int            g_height           = 768;
+int            g_warmupFrames     = 5;
+int            g_frames           = 50;
+std::string    g_outputFile       = "scene_benchmark.csv";
+const char*    g_baselineFile     = nullptr;
+float          g_tolerance        = 0.1f;
+
+int ENTRY_POINT();
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static void printUsage()
+{
+	std::cout << "./ANARI-Scene-Benchmark [{--help|-h}]\n"
+			  << "   [{--verbose|-v}]\n"
+			  << "   [{--library|-l} <ANARI library>]\n"
+			  << "   [--category <category>] [--scene <scene>]\n"
+			  << "   [--size <width>x<height>]\n"
+			  << "   [--warmup <frames>] [--frames <frames>]\n"
+			  << "   [{--output|-o} <report.csv>]\n"
+			  << "   [--baseline <report.csv>] [--tolerance <fraction, 0.1 is 10%>]\n\n"
+			  << "Runs every scene of anari_test_scenes, or the selected ones, and writes\n"
+			  << "scene creation, commit, first frame and steady state frame times and the\n"
+			  << "peak resident memory of each to the report. With a baseline report the\n"
+			  << "exit code is 1 when a scene got slower or larger than the tolerance.\n";
+}
+
+static void parseCommandLine(int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h") {
+			printUsage();
+			std::exit(0);
+		} else if (arg == "-v" || arg == "--verbose")
+			g_verbose = true;
+		else if (arg == "-l" || arg == "--library")
+			g_libraryName = argv[++i];
+		else if (arg == "--category")
+			g_categoryName = argv[++i];
+		else if (arg == "--scene")
+			g_sceneName = argv[++i];
+		else if (arg == "--size") {
+			const std::string size = argv[++i];
+			const size_t x = size.find('x');
+			if (x != std::string::npos) {
+				g_width = std::max(1, std::atoi(size.substr(0, x).c_str()));
+				g_height = std::max(1, std::atoi(size.substr(x + 1).c_str()));
+			}
+		} else if (arg == "--warmup")
+			g_warmupFrames = std::max(0, std::atoi(argv[++i]));
+		else if (arg == "--frames")
+			g_frames = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "-o" || arg == "--output")
+			g_outputFile = argv[++i];
+		else if (arg == "--baseline")
+			g_baselineFile = argv[++i];
+		else if (arg == "--tolerance")
+			g_tolerance = std::max(0.f, float(std::atof(argv[++i])));
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	parseCommandLine(argc, argv);
+	return ENTRY_POINT();
+}
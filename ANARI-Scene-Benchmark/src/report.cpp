@@ -0,0 +1,137 @@
+#include "report.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+static const char* HEADER =
+	"category,scene,status,create_ms,commit_ms,first_frame_ms,frame_ms,frame_p95_ms,peak_rss_mb";
+
+struct Metric {
+	const char* name;
+	float SceneResult::* value;
+	// changes below this are noise whatever the relative change, in the metric's unit
+	float floor;
+};
+
+static const Metric METRICS[] = {
+	{"create_ms", &SceneResult::createMS, 1.f},
+	{"commit_ms", &SceneResult::commitMS, 1.f},
+	{"first_frame_ms", &SceneResult::firstFrameMS, 1.f},
+	{"frame_ms", &SceneResult::frameMS, 0.5f},
+	{"frame_p95_ms", &SceneResult::frameP95MS, 0.5f},
+	{"peak_rss_mb", &SceneResult::peakRSSMB, 4.f},
+};
+
+bool write_report(const char* fileName, const std::vector<SceneResult>& results) {
+	FILE* file = fopen(fileName, "w");
+	if (!file) {
+		return false;
+	}
+
+	fprintf(file, "%s\n", HEADER);
+	for (const auto& r : results) {
+		fprintf(file, "%s,%s,%s,%.4f,%.4f,%.4f,%.4f,%.4f,%.2f\n",
+			r.category.c_str(), r.scene.c_str(), r.ok ? "ok" : "failed",
+			r.createMS, r.commitMS, r.firstFrameMS, r.frameMS, r.frameP95MS, r.peakRSSMB);
+	}
+
+	fclose(file);
+	return true;
+}
+
+bool read_report(const char* fileName, std::vector<SceneResult>& results) {
+	FILE* file = fopen(fileName, "r");
+	if (!file) {
+		return false;
+	}
+
+	results.clear();
+
+	char line[1024];
+	bool header = true;
+	while (fgets(line, sizeof(line), file)) {
+		if (header) {
+			header = false;
+			continue;
+		}
+
+		std::vector<std::string> fields;
+		std::stringstream row(line);
+		for (std::string field; std::getline(row, field, ',');) {
+			fields.push_back(field);
+		}
+		if (fields.size() < 9) {
+			continue;
+		}
+
+		SceneResult r;
+		r.category = fields[0];
+		r.scene = fields[1];
+		r.ok = fields[2] == "ok";
+		r.createMS = float(std::atof(fields[3].c_str()));
+		r.commitMS = float(std::atof(fields[4].c_str()));
+		r.firstFrameMS = float(std::atof(fields[5].c_str()));
+		r.frameMS = float(std::atof(fields[6].c_str()));
+		r.frameP95MS = float(std::atof(fields[7].c_str()));
+		r.peakRSSMB = float(std::atof(fields[8].c_str()));
+		results.push_back(r);
+	}
+
+	fclose(file);
+	return true;
+}
+
+static const SceneResult* find_scene(const std::vector<SceneResult>& results, const SceneResult& scene) {
+	for (const auto& r : results) {
+		if (r.category == scene.category && r.scene == scene.scene) {
+			return &r;
+		}
+	}
+	return nullptr;
+}
+
+int compare_reports(const std::vector<SceneResult>& baseline, const std::vector<SceneResult>& current, float tolerance) {
+	int regressions = 0;
+
+	for (const auto& r : current) {
+		const SceneResult* base = find_scene(baseline, r);
+		if (base == nullptr) {
+			printf("  new      %s/%s\n", r.category.c_str(), r.scene.c_str());
+			continue;
+		}
+		if (base->ok != r.ok) {
+			printf("  %-8s %s/%s\n", r.ok ? "fixed" : "FAILED", r.category.c_str(), r.scene.c_str());
+			regressions += r.ok ? 0 : 1;
+			continue;
+		}
+		if (!r.ok) {
+			continue;
+		}
+
+		for (const auto& m : METRICS) {
+			const float was = (*base).*m.value;
+			const float is = r.*m.value;
+			const float change = is - was;
+			if (std::abs(change) <= m.floor || std::abs(change) <= tolerance * was) {
+				continue;
+			}
+
+			// every metric is better lower
+			const bool worse = change > 0.f;
+			printf("  %-8s %s/%s %s: %.2f -> %.2f (%+.0f%%)\n",
+				worse ? "WORSE" : "better", r.category.c_str(), r.scene.c_str(), m.name,
+				was, is, was > 0.f ? 100.f * change / was : 100.f);
+			regressions += worse ? 1 : 0;
+		}
+	}
+
+	for (const auto& base : baseline) {
+		if (find_scene(current, base) == nullptr) {
+			printf("  missing  %s/%s\n", base.category.c_str(), base.scene.c_str());
+		}
+	}
+
+	return regressions;
+}
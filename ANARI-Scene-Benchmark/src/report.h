@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Measurements of one test scene, times in milliseconds
+struct SceneResult {
+	std::string category;
+	std::string scene;
+	bool ok = false; // false when the scene failed to build
+	float createMS = 0.f; // anari::scenes::createScene()
+	float commitMS = 0.f; // anari::scenes::commit()
+	float firstFrameMS = 0.f; // frame setup, render and wait of the first frame
+	float frameMS = 0.f; // median of the steady state frames
+	float frameP95MS = 0.f;
+	float peakRSSMB = 0.f; // resident set high water mark while the scene ran
+};
+
+// CSV with a header row, one row per scene
+bool write_report(const char* fileName, const std::vector<SceneResult>& results);
+bool read_report(const char* fileName, std::vector<SceneResult>& results);
+
+// Prints every metric that moved by more than tolerance (a fraction) relative to the
+// baseline, returns the number of regressions. Scenes missing on either side are listed
+// but do not count.
+int compare_reports(const std::vector<SceneResult>& baseline, const std::vector<SceneResult>& current, float tolerance);
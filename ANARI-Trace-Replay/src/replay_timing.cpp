@@ -0,0 +1,155 @@
+#define REPLAY_TIMING_IMPLEMENTATION
+#include "replay_timing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+static const char* CATEGORY_NAMES[REPLAY_CATEGORY_COUNT] = {
+	"create", "array", "parameter", "commit", "render", "map", "property", "release", "other",
+};
+
+struct CallStats {
+	uint64_t calls = 0;
+	uint64_t totalNS = 0;
+	uint64_t maxNS = 0;
+
+	void add(uint64_t ns) {
+		calls++;
+		totalNS += ns;
+		maxNS = std::max(maxNS, ns);
+	}
+};
+
+struct SlowCall {
+	uint64_t index; // position of the call in the trace, counted from 0
+	const char* function;
+	uint64_t ns;
+};
+
+static const size_t SLOWEST_CALLS = 10;
+
+// the trace replays on one thread, no locking
+static CallStats                             g_categories[REPLAY_CATEGORY_COUNT];
+static std::map<std::string, CallStats>      g_functions;
+static std::vector<SlowCall>                 g_slowest; // sorted, slowest first
+static uint64_t                              g_callCount = 0;
+static uint64_t                              g_replayStart = 0;
+
+static uint64_t now_ns() {
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static double ms(uint64_t ns) {
+	return double(ns) * 1e-6;
+}
+
+static void write_csv(const char* fileName) {
+	FILE* file = fopen(fileName, "w");
+	if (!file) {
+		fprintf(stderr, "failed to write replay report '%s'\n", fileName);
+		return;
+	}
+
+	fprintf(file, "function,calls,total_ms,mean_ms,max_ms\n");
+	for (const auto& [function, s] : g_functions) {
+		fprintf(file, "%s,%llu,%.4f,%.6f,%.4f\n", function.c_str(), (unsigned long long)s.calls,
+			ms(s.totalNS), ms(s.totalNS) / double(s.calls), ms(s.maxNS));
+	}
+
+	fclose(file);
+	printf("report saved to '%s'\n", fileName);
+}
+
+static void print_report() {
+	const uint64_t wallNS = now_ns() - g_replayStart;
+	uint64_t tracedNS = 0;
+	for (const auto& c : g_categories) {
+		tracedNS += c.totalNS;
+	}
+	const double percentOf = tracedNS > 0 ? 100.0 / double(tracedNS) : 0.0;
+
+	printf("\nreplayed %llu ANARI calls in %.2fms, %.2fms of it inside ANARI\n",
+		(unsigned long long)g_callCount, ms(wallNS), ms(tracedNS));
+
+	int categories[REPLAY_CATEGORY_COUNT];
+	for (int i = 0; i < REPLAY_CATEGORY_COUNT; i++) {
+		categories[i] = i;
+	}
+	std::sort(categories, categories + REPLAY_CATEGORY_COUNT, [](int a, int b) {
+		return g_categories[a].totalNS > g_categories[b].totalNS;
+	});
+
+	printf("\n%-12s %10s %12s %8s %12s\n", "category", "calls", "total ms", "share", "max ms");
+	for (int i : categories) {
+		const CallStats& s = g_categories[i];
+		if (s.calls == 0) {
+			continue;
+		}
+		printf("%-12s %10llu %12.3f %7.1f%% %12.3f\n", CATEGORY_NAMES[i], (unsigned long long)s.calls,
+			ms(s.totalNS), double(s.totalNS) * percentOf, ms(s.maxNS));
+	}
+
+	std::vector<std::pair<std::string, CallStats>> functions(g_functions.begin(), g_functions.end());
+	std::sort(functions.begin(), functions.end(), [](const auto& a, const auto& b) {
+		return a.second.totalNS > b.second.totalNS;
+	});
+
+	printf("\n%-28s %10s %12s %8s %12s\n", "hotspot", "calls", "total ms", "share", "mean ms");
+	for (size_t i = 0; i < std::min<size_t>(10, functions.size()); i++) {
+		const auto& [function, s] = functions[i];
+		printf("%-28s %10llu %12.3f %7.1f%% %12.4f\n", function.c_str(), (unsigned long long)s.calls,
+			ms(s.totalNS), double(s.totalNS) * percentOf, ms(s.totalNS) / double(s.calls));
+	}
+
+	// every function of the ANARI 1.0 C API is wrapped, so the index is the position of the
+	// call among the ANARI calls in trace.c
+	printf("\n%-28s %10s %12s\n", "slowest call", "index", "ms");
+	for (const auto& c : g_slowest) {
+		printf("%-28s %10llu %12.3f\n", c.function, (unsigned long long)c.index, ms(c.ns));
+	}
+
+	if (const char* csv = std::getenv("ANARI_REPLAY_REPORT")) {
+		write_csv(csv);
+	}
+}
+
+uint64_t replay_begin(void) {
+	const uint64_t now = now_ns();
+	if (g_replayStart == 0) {
+		g_replayStart = now;
+		std::atexit(print_report);
+	}
+	return now;
+}
+
+void replay_end(ReplayCategory category, const char* function, uint64_t begin) {
+	const uint64_t ns = now_ns() - begin;
+
+	g_categories[category].add(ns);
+	g_functions[function].add(ns);
+
+	const uint64_t index = g_callCount++;
+	if (g_slowest.size() < SLOWEST_CALLS || ns > g_slowest.back().ns) {
+		const SlowCall call = {index, function, ns};
+		g_slowest.insert(std::upper_bound(g_slowest.begin(), g_slowest.end(), call,
+			[](const SlowCall& a, const SlowCall& b) { return a.ns > b.ns; }), call);
+		if (g_slowest.size() > SLOWEST_CALLS) {
+			g_slowest.pop_back();
+		}
+	}
+}
+
+const char* replay_library(const char* recorded) {
+	const char* library = std::getenv("ANARI_REPLAY_LIBRARY");
+	if (library == nullptr || library[0] == '\0') {
+		return recorded;
+	}
+	printf("replaying against '%s' instead of '%s'\n", library, recorded);
+	return library;
+}
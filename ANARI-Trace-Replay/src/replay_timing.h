@@ -0,0 +1,183 @@
+#pragma once
+
+// Force-included into a trace.c captured by the ANARI debug device (traceMode=code). Every
+// function of anari.h the trace calls goes through a wrapper below that times it, the totals
+// per category and function are printed when the replay exits. This header is C, like the trace.
+
+#include <anari/anari.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum ReplayCategory {
+	REPLAY_CREATE,    // libraries, devices and objects other than arrays
+	REPLAY_ARRAY,     // array creation, array and parameter array mapping
+	REPLAY_PARAMETER, // setting and unsetting parameters
+	REPLAY_COMMIT,
+	REPLAY_RENDER,    // anariRenderFrame and waiting on anariFrameReady
+	REPLAY_MAP,       // mapping frame channels
+	REPLAY_PROPERTY,  // anariGetProperty, which may wait on the device
+	REPLAY_RELEASE,
+	REPLAY_OTHER,     // introspection, modules, retaining and discarding frames
+	REPLAY_CATEGORY_COUNT
+} ReplayCategory;
+
+// steady clock in nanoseconds
+uint64_t replay_begin(void);
+void replay_end(ReplayCategory category, const char* function, uint64_t begin);
+
+// ANARI_REPLAY_LIBRARY, when set, replaces the library the trace was captured with
+const char* replay_library(const char* recorded);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifndef REPLAY_TIMING_IMPLEMENTATION
+
+#define REPLAY_WRAP(type, category, function, params, args) \
+	static inline type replay_##function params { \
+		const uint64_t begin = replay_begin(); \
+		type result = function args; \
+		replay_end(category, #function, begin); \
+		return result; \
+	}
+
+#define REPLAY_WRAP_VOID(category, function, params, args) \
+	static inline void replay_##function params { \
+		const uint64_t begin = replay_begin(); \
+		function args; \
+		replay_end(category, #function, begin); \
+	}
+
+static inline ANARILibrary replay_anariLoadLibrary(const char* name, ANARIStatusCallback callback, const void* userData) {
+	const uint64_t begin = replay_begin();
+	ANARILibrary result = anariLoadLibrary(replay_library(name), callback, userData);
+	replay_end(REPLAY_CREATE, "anariLoadLibrary", begin);
+	return result;
+}
+
+REPLAY_WRAP_VOID(REPLAY_RELEASE, anariUnloadLibrary, (ANARILibrary l), (l))
+REPLAY_WRAP_VOID(REPLAY_OTHER, anariLoadModule, (ANARILibrary l, const char* n), (l, n))
+REPLAY_WRAP_VOID(REPLAY_OTHER, anariUnloadModule, (ANARILibrary l, const char* n), (l, n))
+REPLAY_WRAP(ANARIDevice, REPLAY_CREATE, anariNewDevice, (ANARILibrary l, const char* t), (l, t))
+
+REPLAY_WRAP(const char**, REPLAY_OTHER, anariGetDeviceSubtypes, (ANARILibrary l), (l))
+REPLAY_WRAP(const char**, REPLAY_OTHER, anariGetDeviceExtensions, (ANARILibrary l, const char* t), (l, t))
+REPLAY_WRAP(const char**, REPLAY_OTHER, anariGetObjectSubtypes, (ANARIDevice d, ANARIDataType o), (d, o))
+REPLAY_WRAP(const void*, REPLAY_OTHER, anariGetObjectInfo,
+	(ANARIDevice d, ANARIDataType o, const char* t, const char* i, ANARIDataType it),
+	(d, o, t, i, it))
+REPLAY_WRAP(const void*, REPLAY_OTHER, anariGetParameterInfo,
+	(ANARIDevice d, ANARIDataType o, const char* t, const char* p, ANARIDataType pt, const char* i, ANARIDataType it),
+	(d, o, t, p, pt, i, it))
+
+REPLAY_WRAP(ANARIArray1D, REPLAY_ARRAY, anariNewArray1D,
+	(ANARIDevice d, const void* m, ANARIMemoryDeleter del, const void* u, ANARIDataType t, uint64_t n1),
+	(d, m, del, u, t, n1))
+REPLAY_WRAP(ANARIArray2D, REPLAY_ARRAY, anariNewArray2D,
+	(ANARIDevice d, const void* m, ANARIMemoryDeleter del, const void* u, ANARIDataType t, uint64_t n1, uint64_t n2),
+	(d, m, del, u, t, n1, n2))
+REPLAY_WRAP(ANARIArray3D, REPLAY_ARRAY, anariNewArray3D,
+	(ANARIDevice d, const void* m, ANARIMemoryDeleter del, const void* u, ANARIDataType t, uint64_t n1, uint64_t n2, uint64_t n3),
+	(d, m, del, u, t, n1, n2, n3))
+REPLAY_WRAP(void*, REPLAY_ARRAY, anariMapArray, (ANARIDevice d, ANARIArray a), (d, a))
+REPLAY_WRAP_VOID(REPLAY_ARRAY, anariUnmapArray, (ANARIDevice d, ANARIArray a), (d, a))
+
+REPLAY_WRAP(ANARILight, REPLAY_CREATE, anariNewLight, (ANARIDevice d, const char* t), (d, t))
+REPLAY_WRAP(ANARICamera, REPLAY_CREATE, anariNewCamera, (ANARIDevice d, const char* t), (d, t))
+REPLAY_WRAP(ANARIGeometry, REPLAY_CREATE, anariNewGeometry, (ANARIDevice d, const char* t), (d, t))
+REPLAY_WRAP(ANARISpatialField, REPLAY_CREATE, anariNewSpatialField, (ANARIDevice d, const char* t), (d, t))
+REPLAY_WRAP(ANARIVolume, REPLAY_CREATE, anariNewVolume, (ANARIDevice d, const char* t), (d, t))
+REPLAY_WRAP(ANARISurface, REPLAY_CREATE, anariNewSurface, (ANARIDevice d), (d))
+REPLAY_WRAP(ANARIMaterial, REPLAY_CREATE, anariNewMaterial, (ANARIDevice d, const char* t), (d, t))
+REPLAY_WRAP(ANARISampler, REPLAY_CREATE, anariNewSampler, (ANARIDevice d, const char* t), (d, t))
+REPLAY_WRAP(ANARIGroup, REPLAY_CREATE, anariNewGroup, (ANARIDevice d), (d))
+REPLAY_WRAP(ANARIInstance, REPLAY_CREATE, anariNewInstance, (ANARIDevice d, const char* t), (d, t))
+REPLAY_WRAP(ANARIWorld, REPLAY_CREATE, anariNewWorld, (ANARIDevice d), (d))
+REPLAY_WRAP(ANARIObject, REPLAY_CREATE, anariNewObject, (ANARIDevice d, const char* o, const char* t), (d, o, t))
+REPLAY_WRAP(ANARIRenderer, REPLAY_CREATE, anariNewRenderer, (ANARIDevice d, const char* t), (d, t))
+REPLAY_WRAP(ANARIFrame, REPLAY_CREATE, anariNewFrame, (ANARIDevice d), (d))
+
+REPLAY_WRAP_VOID(REPLAY_PARAMETER, anariSetParameter,
+	(ANARIDevice d, ANARIObject o, const char* n, ANARIDataType t, const void* m), (d, o, n, t, m))
+REPLAY_WRAP_VOID(REPLAY_PARAMETER, anariUnsetParameter, (ANARIDevice d, ANARIObject o, const char* n), (d, o, n))
+REPLAY_WRAP_VOID(REPLAY_PARAMETER, anariUnsetAllParameters, (ANARIDevice d, ANARIObject o), (d, o))
+REPLAY_WRAP(void*, REPLAY_ARRAY, anariMapParameterArray1D,
+	(ANARIDevice d, ANARIObject o, const char* n, ANARIDataType t, uint64_t n1, uint64_t* s),
+	(d, o, n, t, n1, s))
+REPLAY_WRAP(void*, REPLAY_ARRAY, anariMapParameterArray2D,
+	(ANARIDevice d, ANARIObject o, const char* n, ANARIDataType t, uint64_t n1, uint64_t n2, uint64_t* s),
+	(d, o, n, t, n1, n2, s))
+REPLAY_WRAP(void*, REPLAY_ARRAY, anariMapParameterArray3D,
+	(ANARIDevice d, ANARIObject o, const char* n, ANARIDataType t, uint64_t n1, uint64_t n2, uint64_t n3, uint64_t* s),
+	(d, o, n, t, n1, n2, n3, s))
+REPLAY_WRAP_VOID(REPLAY_ARRAY, anariUnmapParameterArray, (ANARIDevice d, ANARIObject o, const char* n), (d, o, n))
+REPLAY_WRAP_VOID(REPLAY_COMMIT, anariCommitParameters, (ANARIDevice d, ANARIObject o), (d, o))
+
+REPLAY_WRAP_VOID(REPLAY_RELEASE, anariRelease, (ANARIDevice d, ANARIObject o), (d, o))
+REPLAY_WRAP_VOID(REPLAY_OTHER, anariRetain, (ANARIDevice d, ANARIObject o), (d, o))
+
+REPLAY_WRAP(int, REPLAY_PROPERTY, anariGetProperty,
+	(ANARIDevice d, ANARIObject o, const char* n, ANARIDataType t, void* m, uint64_t size, ANARIWaitMask w),
+	(d, o, n, t, m, size, w))
+
+REPLAY_WRAP(const void*, REPLAY_MAP, anariMapFrame,
+	(ANARIDevice d, ANARIFrame f, const char* c, uint32_t* w, uint32_t* h, ANARIDataType* t),
+	(d, f, c, w, h, t))
+REPLAY_WRAP_VOID(REPLAY_MAP, anariUnmapFrame, (ANARIDevice d, ANARIFrame f, const char* c), (d, f, c))
+REPLAY_WRAP_VOID(REPLAY_RENDER, anariRenderFrame, (ANARIDevice d, ANARIFrame f), (d, f))
+REPLAY_WRAP(int, REPLAY_RENDER, anariFrameReady, (ANARIDevice d, ANARIFrame f, ANARIWaitMask w), (d, f, w))
+REPLAY_WRAP_VOID(REPLAY_OTHER, anariDiscardFrame, (ANARIDevice d, ANARIFrame f), (d, f))
+
+#undef REPLAY_WRAP
+#undef REPLAY_WRAP_VOID
+
+#define anariLoadLibrary replay_anariLoadLibrary
+#define anariUnloadLibrary replay_anariUnloadLibrary
+#define anariLoadModule replay_anariLoadModule
+#define anariUnloadModule replay_anariUnloadModule
+#define anariNewDevice replay_anariNewDevice
+#define anariGetDeviceSubtypes replay_anariGetDeviceSubtypes
+#define anariGetDeviceExtensions replay_anariGetDeviceExtensions
+#define anariGetObjectSubtypes replay_anariGetObjectSubtypes
+#define anariGetObjectInfo replay_anariGetObjectInfo
+#define anariGetParameterInfo replay_anariGetParameterInfo
+#define anariNewArray1D replay_anariNewArray1D
+#define anariNewArray2D replay_anariNewArray2D
+#define anariNewArray3D replay_anariNewArray3D
+#define anariMapArray replay_anariMapArray
+#define anariUnmapArray replay_anariUnmapArray
+#define anariNewLight replay_anariNewLight
+#define anariNewCamera replay_anariNewCamera
+#define anariNewGeometry replay_anariNewGeometry
+#define anariNewSpatialField replay_anariNewSpatialField
+#define anariNewVolume replay_anariNewVolume
+#define anariNewSurface replay_anariNewSurface
+#define anariNewMaterial replay_anariNewMaterial
+#define anariNewSampler replay_anariNewSampler
+#define anariNewGroup replay_anariNewGroup
+#define anariNewInstance replay_anariNewInstance
+#define anariNewWorld replay_anariNewWorld
+#define anariNewObject replay_anariNewObject
+#define anariNewRenderer replay_anariNewRenderer
+#define anariNewFrame replay_anariNewFrame
+#define anariSetParameter replay_anariSetParameter
+#define anariUnsetParameter replay_anariUnsetParameter
+#define anariUnsetAllParameters replay_anariUnsetAllParameters
+#define anariMapParameterArray1D replay_anariMapParameterArray1D
+#define anariMapParameterArray2D replay_anariMapParameterArray2D
+#define anariMapParameterArray3D replay_anariMapParameterArray3D
+#define anariUnmapParameterArray replay_anariUnmapParameterArray
+#define anariCommitParameters replay_anariCommitParameters
+#define anariRelease replay_anariRelease
+#define anariRetain replay_anariRetain
+#define anariGetProperty replay_anariGetProperty
+#define anariMapFrame replay_anariMapFrame
+#define anariUnmapFrame replay_anariUnmapFrame
+#define anariRenderFrame replay_anariRenderFrame
+#define anariFrameReady replay_anariFrameReady
+#define anariDiscardFrame replay_anariDiscardFrame
+
+#endif // REPLAY_TIMING_IMPLEMENTATION
@@ -1,6 +1,7 @@
 #pragma once
 
 // Tip: This file is included by all examples to define common macros and includes.
+#include <stddef.h>
 #include <stdint.h>
 
 typedef uint8_t  u8;
@@ -145,3 +146,219 @@ typedef char32_t* str32;
         LOG_FATAL ("Assertion failed: " #expr);                                          \
         LOG_FATAL_FORMAT (fmt, __VA_ARGS__);                                             \
     }
+
+
+// Scoped CPU tracing, written out as Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev)
+//
+//   TRACE_ENABLE (true);         // recording is off until enabled at runtime
+//   TRACE_SCOPE ("draw_ui");     // records one complete event for the enclosing scope
+//   TRACE_WRITE ("trace.json");  // dumps the events of every thread
+//
+// Every thread appends to its own fixed-size buffer without locking, a disabled scope costs
+// one relaxed atomic load. Define DISABLE_TRACING to compile all TRACE_* macros away.
+#ifdef __cplusplus
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+	struct event {
+		cstr name;
+		u64  begin_ns;
+		u64  end_ns;
+	};
+
+	struct thread_buffer {
+		static constexpr usize CAPACITY = usize (1) << 16;
+
+		u32                thread_id = 0;
+		std::atomic<usize> count { 0 };
+		std::atomic<usize> dropped { 0 };
+		event              events[CAPACITY];
+	};
+
+	struct registry {
+		std::mutex                                  mutex;
+		std::vector<std::unique_ptr<thread_buffer>> buffers;
+	};
+
+	inline std::atomic<b8> g_enabled { false };
+	inline registry        g_registry;
+
+	inline u64 now_ns () {
+		using namespace std::chrono;
+		return u64 (duration_cast<nanoseconds> (steady_clock::now ().time_since_epoch ()).count ());
+	}
+
+	// buffers outlive their threads so events can be written after a worker exits
+	inline thread_buffer* this_thread_buffer () {
+		thread_local thread_buffer* buffer = nullptr;
+		if (buffer == nullptr) {
+			auto new_buffer = std::make_unique<thread_buffer> ();
+
+			std::lock_guard<std::mutex> lock (g_registry.mutex);
+			new_buffer->thread_id = u32 (g_registry.buffers.size ()) + 1;
+			buffer                = new_buffer.get ();
+			g_registry.buffers.push_back (std::move (new_buffer));
+		}
+		return buffer;
+	}
+
+	inline void record (cstr name, u64 begin_ns, u64 end_ns) {
+		thread_buffer* buffer = this_thread_buffer ();
+		const usize    index  = buffer->count.load (std::memory_order_relaxed);
+		if (index >= thread_buffer::CAPACITY) {
+			buffer->dropped.fetch_add (1, std::memory_order_relaxed);
+			return;
+		}
+		buffer->events[index] = { name, begin_ns, end_ns };
+		buffer->count.store (index + 1, std::memory_order_release);
+	}
+
+	inline void enable (b8 enabled) { g_enabled.store (enabled, std::memory_order_relaxed); }
+
+	inline b8 enabled () { return g_enabled.load (std::memory_order_relaxed); }
+
+	// events recorded after this call are not guaranteed to be part of the file
+	inline b8 write (cstr file_name) {
+		FILE* file = fopen (file_name, "w");
+		if (file == nullptr) {
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock (g_registry.mutex);
+
+		u64 origin_ns = ~u64 (0);
+		for (auto& buffer : g_registry.buffers) {
+			const usize count = buffer->count.load (std::memory_order_acquire);
+			for (usize i = 0; i < count; i++) {
+				origin_ns = buffer->events[i].begin_ns < origin_ns ? buffer->events[i].begin_ns : origin_ns;
+			}
+		}
+
+		fprintf (file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+		b8 first = true;
+		for (auto& buffer : g_registry.buffers) {
+			const usize count = buffer->count.load (std::memory_order_acquire);
+			for (usize i = 0; i < count; i++) {
+				const event& e = buffer->events[i];
+				fprintf (file, "%s\n{\"name\":\"", first ? "" : ",");
+				for (cstr p = e.name; *p != '\0'; p++) {
+					if (*p == '"' || *p == '\\') {
+						fputc ('\\', file);
+					}
+					fputc (*p, file);
+				}
+				fprintf (file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", buffer->thread_id,
+				         f64 (e.begin_ns - origin_ns) / 1000.0, f64 (e.end_ns - e.begin_ns) / 1000.0);
+				first = false;
+			}
+			const usize dropped = buffer->dropped.load (std::memory_order_relaxed);
+			if (dropped > 0) {
+				fprintf (stderr, "[WARN] trace buffer of thread %u was full, %zu events dropped\n",
+				         buffer->thread_id, dropped);
+			}
+		}
+		fprintf (file, "\n]}\n");
+
+		fclose (file);
+		return true;
+	}
+
+	struct scope {
+		cstr name;
+		u64  begin_ns = 0;
+
+		explicit scope (cstr n) : name (enabled () ? n : nullptr) {
+			if (name != nullptr) {
+				begin_ns = now_ns ();
+			}
+		}
+
+		~scope () {
+			if (name != nullptr) {
+				record (name, begin_ns, now_ns ());
+			}
+		}
+
+		scope (const scope&)            = delete;
+		scope& operator= (const scope&) = delete;
+	};
+} // namespace trace
+
+#define _TRACE_CONCAT_(a, b) a##b
+#define _TRACE_NAME_(line)   _TRACE_CONCAT_ (trace_scope_, line)
+
+#ifndef DISABLE_TRACING
+	#define TRACE_SCOPE(name)     ::trace::scope _TRACE_NAME_ (__LINE__) (name)
+	#define TRACE_ENABLE(enabled) ::trace::enable (enabled)
+	#define TRACE_WRITE(file)     ::trace::write (file)
+#else
+	#define TRACE_SCOPE(name)
+	#define TRACE_ENABLE(enabled)
+	#define TRACE_WRITE(file) false
+#endif
+
+
+// Bounded lock-free queue, any number of threads may push, a single thread pops
+//
+//   mpsc_queue<ANARIFrame, 64> done;
+//   done.push (frame);           // e.g. from a device callback, false when full
+//   while (done.pop (frame)) {}  // on the consuming thread
+//
+// Every cell carries a sequence number telling whether it is free for the push at that position
+// or holds the value for the pop at that position (D. Vyukov's bounded queue).
+template <typename T, usize CAPACITY> struct mpsc_queue {
+	static_assert ((CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+
+	struct cell {
+		std::atomic<usize> sequence;
+		T                  value;
+	};
+
+	cell                           cells[CAPACITY];
+	alignas (64) std::atomic<usize> head { 0 }; // next position to push
+	alignas (64) usize              tail = 0;   // next position to pop, consumer only
+
+	mpsc_queue () {
+		for (usize i = 0; i < CAPACITY; i++) {
+			cells[i].sequence.store (i, std::memory_order_relaxed);
+		}
+	}
+
+	mpsc_queue (const mpsc_queue&)            = delete;
+	mpsc_queue& operator= (const mpsc_queue&) = delete;
+
+	b8 push (const T& value) {
+		usize pos = head.load (std::memory_order_relaxed);
+		for (;;) {
+			cell&       c    = cells[pos & (CAPACITY - 1)];
+			const isize diff = isize (c.sequence.load (std::memory_order_acquire)) - isize (pos);
+			if (diff == 0) {
+				if (head.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed)) {
+					c.value = value;
+					c.sequence.store (pos + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (diff < 0) {
+				return false;
+			} else {
+				pos = head.load (std::memory_order_relaxed);
+			}
+		}
+	}
+
+	b8 pop (T& value) {
+		cell& c = cells[tail & (CAPACITY - 1)];
+		if (isize (c.sequence.load (std::memory_order_acquire)) - isize (tail + 1) < 0) {
+			return false;
+		}
+		value = c.value;
+		c.sequence.store (tail + CAPACITY, std::memory_order_release);
+		tail++;
+		return true;
+	}
+};
+#endif // __cplusplus